@@ -113,99 +113,11 @@ public:
             }
 
             condition.op = CompOp::LIKE;
-            auto mysqlLike = where->String()->getText();
-            mysqlLike = mysqlLike.substr(1, mysqlLike.size() - 1);
-            std::string regexLike;
-            int mode = 0, pct_cnt = 0, udl_cnt = 0;
-            for (auto c : mysqlLike)
-            {
-                switch (c)
-                {
-                case '%':
-                    switch (mode)
-                    {
-                    case 0:
-                        mode = 1;
-                        pct_cnt++;
-                        break;
-                    case 1:
-                        pct_cnt++;
-                        break;
-                    case 2:
-                        regexLike += "[^\']{" + std::to_string(udl_cnt) + "}";
-                        mode = 1;
-                        break;
-
-                    default:
-                        break;
-                    }
-                    break;
-                case '_':
-                    switch (mode)
-                    {
-                    case 0:
-                        mode = 2;
-                        udl_cnt++;
-                        break;
-                    case 1:
-                        regexLike += "[^\']*";
-                        mode = 2;
-                        break;
-                    case 2:
-                        udl_cnt++;
-                        break;
-
-                    default:
-                        break;
-                    }
-                    break;
-                case '\'':
-                    switch (mode)
-                    {
-                    case 0:
-                        break;
-                    case 1:
-                        regexLike += "[^\']*";
-                        mode = 0;
-                        pct_cnt = 0;
-                        break;
-                    case 2:
-                        regexLike += "[^\']{" + std::to_string(udl_cnt) + "}";
-                        mode = 0;
-                        udl_cnt = 0;
-                        break;
-
-                    default:
-                        break;
-                    }
-                    break;
-                default:
-                    switch (mode)
-                    {
-                    case 0:
-                        regexLike += c;
-                        break;
-                    case 1:
-                        regexLike += "[^\']*";
-                        regexLike += c;
-                        mode = 0;
-                        pct_cnt = 0;
-                        break;
-                    case 2:
-                        regexLike += "[^\']{" + std::to_string(udl_cnt) + "}";
-                        regexLike += c;
-                        mode = 0;
-                        udl_cnt = 0;
-                        break;
-
-                    default:
-                        break;
-                    }
-                    break;
-                }
-            }
-            condition.rhsValue.len = regexLike.size();
-            strcpy(condition.rhsValue.pData.String, regexLike.c_str());
+            // keep the SQL pattern without its quotes; LikeMatcher interprets % and _
+            auto like = where->String()->getText();
+            like = like.substr(1, like.size() - 2);
+            condition.rhsValue.len = like.size();
+            strcpy(condition.rhsValue.pData.String, like.c_str());
         }
         else if (auto where = dynamic_cast<SQLParser::Where_nullContext *>(ctx))
         {
@@ -3,46 +3,854 @@
 #include "../utils/MyHashMap.h"
 #include "../utils/MyBitMap.h"
 #include "FindReplace.h"
+#include "TwoQReplace.h"
+#include "FrameArena.h"
 #include "../utils/pagedef.h"
 #include "../fileio/FileManager.h"
 #include "../utils/MyLinkList.h"
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <pthread.h>
+#include <new>
+/*
+ * ReadAhead
+ * 扫描向缓存管理器声明的访问模式，由readAhead根据扫描的进度提前发出异步读
+ * 顺序模式预读[next, end)中的页面，列表模式按顺序预读pages中的页面
+ * 顺序模式读入的页面只会被访问一次，替换算法会优先替换它们
+ */
+struct ReadAhead {
+	int fileID;
+	bool sequential;
+	int next, end;
+	std::vector<int> pages;
+	size_t pos;
+	ReadAhead() {
+		fileID = -1;
+		sequential = true;
+		next = end = 0;
+		pos = 0;
+	}
+};
+/*
+ * 页面闩锁的模式，PageGuard固定页面之后按照这个模式对页面加锁
+ */
+enum PageLatch {
+	LATCH_NONE,
+	LATCH_SHARED,
+	LATCH_EXCLUSIVE
+};
+/*
+ * BufShard
+ * 缓存的一个分片，页面由(文件号,页号)的hash值决定所在的分片
+ * 每个分片有自己的hash表、替换算法和latch，不同分片上的操作可以同时进行
+ * 缓存页面i属于第i%n个分片，在分片的hash表和替换算法中的下标为i/n
+ */
+struct BufShard {
+	int id;
+	/*
+	 * 分片中缓存页面的个数
+	 */
+	int cap;
+	int last;
+	MyHashMap* hash;
+	Replacer* replace;
+	/*
+	 * 保护分片的hash表、替换算法，以及属于分片的缓存页面的状态
+	 */
+	std::recursive_mutex latch;
+};
 /*
  * BufPageManager
  * 实现了一个缓存的管理器
+ * 可以被多个线程同时使用，加锁的顺序为:页面闩锁，分片的latch，fileLatch或ioLatch
+ * 同一时刻一个线程最多持有一个分片的latch，只有resize会按顺序持有所有分片的latch
  */
 struct BufPageManager {
 public:
-	int last;
+	/*
+	 * 缓存页面个数
+	 */
+	int CAP_;
+	int shardNum;
+	BufShard* shards;
 	FileManager* fileManager;
-	MyHashMap* hash;
-	FindReplace* replace;
-	//MyLinkList* bpl;
-	bool* dirty;
 	/*
-	 * 缓存页面数组
+	 * 每个文件一个链表，链接该文件在缓存中的所有页面，用于按文件写回和归还
+	 */
+	MyLinkList* bpl;
+	/*
+	 * 保护bpl
+	 */
+	std::mutex fileLatch;
+	/*
+	 * 保护文件管理器的异步读写队列，异步读写的实现不是线程安全的
+	 */
+	std::mutex ioLatch;
+	std::atomic<bool>* dirty;
+	/*
+	 * 上次commit取走脏页之后是否有页面被标记为脏页，没有时commit不扫描缓存页面
+	 */
+	std::atomic<bool> dirtied;
+	/*
+	 * 缓存页面上是否有还没有完成的异步读写
+	 * 有在途请求的页面在完成之前不会被交给调用者，也不会被替换
+	 */
+	std::atomic<bool>* pending;
+	/*
+	 * 缓存页面上的异步读是否失败，失败的页面内容无效
+	 * 完成时只持有ioLatch，不能修改hash表，由下一次持有分片latch的访问归还页面
+	 */
+	std::atomic<bool>* readFailed;
+	/*
+	 * 缓存页面被固定的次数，被固定的页面不会被替换，地址在解除固定之前一直有效
+	 */
+	int* pins;
+	/*
+	 * 缓存页面数组，页面的地址由所在的FrameArena和序号算出，构造和resize时确定
 	 */
 	BufType* addr;
-	BufType allocMem() {
-		return new unsigned int[(PAGE_SIZE >> 2)];
+	/*
+	 * 存放缓存页面的内存，每次扩大缓存时为新增的页面分配一段
+	 * arenaStart[i]为arenas[i]中第一个页面在缓存页面数组中的下标
+	 */
+	std::vector<FrameArena*> arenas;
+	std::vector<int> arenaStart;
+	/*
+	 * 每个缓存页面的读写锁，由调用者在固定页面之后加锁，保护页面的内容
+	 * 单独分配，resize时地址不变
+	 */
+	pthread_rwlock_t** frameLatch;
+	/*
+	 * 后台写回线程
+	 */
+	std::thread flusher;
+	std::mutex flushMutex;
+	std::condition_variable flushCv;
+	bool flushStop;
+	/*
+	 * 被取走脏页标记、等待写回的页面，写回期间页面被固定
+	 */
+	struct DirtyPage {
+		int fileID;
+		int pageID;
+		int index;
+		BufType buf;
+		bool operator<(const DirtyPage& other) const {
+			return (fileID != other.fileID) ? (fileID < other.fileID) : (pageID < other.pageID);
+		}
+	};
+	/*
+	 * 预读时文件中相邻的若干个页面合并成的一个异步读请求
+	 * index[i]为文件页pageID+i所在的缓存页面，iov[i]为它的地址
+	 */
+	struct ReadRun {
+		int fileID;
+		int pageID;
+		int n;
+		int index[IO_RUN_PAGES];
+		struct iovec iov[IO_RUN_PAGES];
+	};
+	/*
+	 * 在途的多页读请求，请求的tag为runs中的下标，由ioLatch保护
+	 */
+	std::vector<ReadRun> runs;
+	std::vector<int> freeRuns;
+	/*
+	 * 为下标从start开始的n个缓存页面分配一段连续的内存
+	 */
+	FrameArena* allocArena(int start, int n) {
+		FrameArena* a = new FrameArena(n);
+		if (!a->valid()) {
+			delete a;
+			return NULL;
+		}
+		arenas.push_back(a);
+		arenaStart.push_back(start);
+		return a;
+	}
+	/*
+	 * 缓存缩小到c个页面后，归还下标不小于c的页面占用的内存
+	 */
+	void freeArenas(int c) {
+		for (size_t i = arenas.size(); i > 0; -- i) {
+			FrameArena* a = arenas[i - 1];
+			int start = arenaStart[i - 1];
+			if (start >= c) {
+				delete a;
+				arenas.erase(arenas.begin() + (i - 1));
+				arenaStart.erase(arenaStart.begin() + (i - 1));
+			} else {
+				a->discard(c - start, a->size());
+			}
+		}
 	}
-	BufType fetchPage(int typeID, int pageID, int& index) {
+	/*
+	 * 第s个分片在缓存页面个数为c时的页面个数
+	 */
+	int shardCap(int s, int c) {
+		return (c > s) ? (c - s + shardNum - 1) / shardNum : 0;
+	}
+	BufShard& shardOf(int fileID, int pageID) {
+		unsigned int h = (unsigned int) fileID * 0x9e3779b1u + (unsigned int) pageID;
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		return shards[h % shardNum];
+	}
+	BufShard& frameShard(int index) {
+		return shards[index % shardNum];
+	}
+	int local(int index) {
+		return index / shardNum;
+	}
+	int global(BufShard& s, int l) {
+		return l * shardNum + s.id;
+	}
+	/*
+	 * 以下划线开头的函数要求调用者已经持有页面所在分片的latch
+	 * fetchPage没有取得页面时返回NULL，调用者释放latch后用_makeRoom腾出页面再重试：
+	 *           替换算法选中的页面是脏页时index为这个页面，分片中所有页面都被固定时index为-1
+	 */
+	BufType fetchPage(BufShard& s, int typeID, int pageID, int& index) {
 		BufType b;
-		index = replace->find();
+		index = -1;
+		if (s.cap == 0) {
+			return NULL;
+		}
+		int l = s.replace->find();
+		for (int tried = 1; pins[global(s, l)] > 0; ++ tried) {
+			// 被固定的页面放回原处
+			s.replace->access(l);
+			if (tried >= s.cap) {
+				return NULL;
+			}
+			l = s.replace->find();
+		}
+		index = global(s, l);
+		_waitFor(index);
+		if (dirty[index]) {
+			// 后台写回没有跟上，由调用者在释放latch之后写回
+			return NULL;
+		}
+		readFailed[index] = false;
 		b = addr[index];
-		if (b == NULL) {
-			b = allocMem();
-			addr[index] = b;
-		} else {
-			if (dirty[index]) {
-				int k1, k2;
-				hash->getKeys(index, k1, k2);
-				fileManager->writePage(k1, k2, b, 0);
-				dirty[index] = false;
+		s.hash->replace(l, typeID, pageID);
+		{
+			std::lock_guard<std::mutex> lock(fileLatch);
+			bpl->insert(typeID, index);
+		}
+		return b;
+	}
+	/*
+	 * 文件页面在缓存中的下标，不在缓存中时返回-1
+	 */
+	int _find(BufShard& s, int fileID, int pageID) {
+		int l = s.hash->findIndex(fileID, pageID);
+		return (l == -1) ? -1 : global(s, l);
+	}
+	BufType _getPage(int fileID, int pageID, int& index, bool pin, bool useOnce = false) {
+		BufShard& s = shardOf(fileID, pageID);
+		int failed = 0;
+		while (true) {
+			int seen;
+			BufType b;
+			{
+				std::lock_guard<std::recursive_mutex> lock(s.latch);
+				index = _find(s, fileID, pageID);
+				if (index != -1) {
+					_waitFor(index);
+					if (!readFailed[index]) {
+						_access(index, useOnce);
+						pins[index] += pin;
+						return addr[index];
+					}
+					// 异步读失败的页面按未命中处理，重新同步读入
+					_unmap(index);
+				}
+				b = _startRead(s, fileID, pageID, index);
+				seen = CAP_;
+			}
+			if (b != NULL) {
+				_finishRead(fileID, pageID, index, pin);
+				return b;
 			}
+			_makeRoom(index, seen, failed);
+		}
+	}
+	/*
+	 * 为未命中的页面取得缓存页面，并在读盘期间标记为在途、固定住
+	 * 读盘由_finishRead在释放分片的latch之后完成，其他线程访问这个页面时等待读完
+	 */
+	BufType _startRead(BufShard& s, int fileID, int pageID, int& index) {
+		BufType b = fetchPage(s, fileID, pageID, index);
+		if (b != NULL) {
+			pending[index] = true;
+			++ pins[index];
 		}
-		hash->replace(index, typeID, pageID);
 		return b;
 	}
+	/*
+	 * 调用者不能持有任何分片的latch
+	 * 读失败时页面内容清零后交给调用者，但页面被移出hash表，之后的访问重新读盘，对它的修改不会写回
+	 * 返回:成功操作返回0，读失败时返回-1
+	 */
+	int _finishRead(int fileID, int pageID, int index, bool pin) {
+		int ret = fileManager->readPage(fileID, pageID, addr[index], 0);
+		if (ret != 0) {
+			memset(addr[index], 0, PAGE_SIZE);
+			// 等待这个页面的线程按异步读失败处理
+			readFailed[index] = true;
+		}
+		pending[index] = false;
+		if (ret != 0) {
+			std::cout << "Error! Failed to read page " << pageID << " of file " << fileID << "." << std::endl;
+			std::lock_guard<std::recursive_mutex> lock(frameShard(index).latch);
+			if (_mapped(index)) {
+				_unmap(index);
+			}
+		}
+		if (!pin) {
+			unpin(index);
+		}
+		return ret;
+	}
+	/*
+	 * 预读不扩大缓存：替换算法选中脏页时写回一次，写失败或分片中所有页面都被固定时放弃预读
+	 */
+	bool _prefetch(int fileID, int pageID) {
+		BufShard& s = shardOf(fileID, pageID);
+		bool wrote = false;
+		while (true) {
+			int index;
+			{
+				std::lock_guard<std::recursive_mutex> lock(s.latch);
+				if (_find(s, fileID, pageID) != -1) {
+					return false;
+				}
+				BufType b = fetchPage(s, fileID, pageID, index);
+				if (b != NULL) {
+					pending[index] = true;
+					_submit(fileID, pageID, b, index, false);
+					return true;
+				}
+			}
+			if (index == -1 || wrote || _writeVictim(index) != 0) {
+				return false;
+			}
+			wrote = true;
+		}
+	}
+	/*
+	 * 为pageIDs中不在缓存中的页面提交异步读，文件中相邻的页面合并为一个向量读请求
+	 * 凑请求期间页面被固定，不会被替换；其他线程等待这些页面时可能持有分片的latch，
+	 * 所以拿不到分片的latch时先提交已经凑好的页面
+	 * 一段请求在一个分片中最多固定一半的页面，超过时先提交，留给前台访问
+	 * 预读不扩大缓存：分片中没有可以替换的页面时放弃剩余的页面，同_prefetch
+	 * 调用者不能持有任何分片的latch
+	 * 返回:提交的页面个数
+	 */
+	int _prefetchPages(int fileID, const int* pageIDs, int n) {
+		ReadRun run;
+		run.fileID = fileID;
+		run.n = 0;
+		int issued = 0;
+		bool wrote = false;
+		int i = 0;
+		while (i < n) {
+			if (run.n > 0 && (run.n == IO_RUN_PAGES || pageIDs[i] != run.pageID + run.n)) {
+				_submitRun(run);
+			}
+			BufShard& s = shardOf(fileID, pageIDs[i]);
+			if (_runPins(run, s) >= s.cap / 2) {
+				_submitRun(run);
+			}
+			std::unique_lock<std::recursive_mutex> lock(s.latch, std::try_to_lock);
+			if (!lock.owns_lock()) {
+				_submitRun(run);
+				lock.lock();
+			}
+			if (_find(s, fileID, pageIDs[i]) != -1) {
+				++ i;
+				continue;
+			}
+			int index;
+			BufType b = fetchPage(s, fileID, pageIDs[i], index);
+			if (b == NULL) {
+				lock.unlock();
+				if (run.n > 0) {
+					// 凑好的页面占住了分片，提交后它们可以被替换，再试一次
+					_submitRun(run);
+					continue;
+				}
+				if (index == -1 || wrote || _writeVictim(index) != 0) {
+					break;
+				}
+				wrote = true;
+				continue;
+			}
+			pending[index] = true;
+			++ pins[index];
+			if (run.n == 0) {
+				run.pageID = pageIDs[i];
+			}
+			run.index[run.n] = index;
+			run.iov[run.n].iov_base = b;
+			run.iov[run.n].iov_len = PAGE_SIZE;
+			++ run.n;
+			++ issued;
+			++ i;
+		}
+		_submitRun(run);
+		return issued;
+	}
+	/*
+	 * run中属于分片s的页面个数
+	 */
+	int _runPins(const ReadRun& run, BufShard& s) {
+		int k = 0;
+		for (int i = 0; i < run.n; ++ i) {
+			k += (run.index[i] % shardNum == s.id);
+		}
+		return k;
+	}
+	/*
+	 * 提交run中凑好的页面，解除固定并清空run，只有一个页面时按单页请求提交
+	 * 调用者不能持有任何分片的latch
+	 */
+	void _submitRun(ReadRun& run) {
+		if (run.n == 1) {
+			_submit(run.fileID, run.pageID, (BufType) run.iov[0].iov_base, run.index[0], false);
+		} else if (run.n > 1) {
+			while (true) {
+				{
+					std::lock_guard<std::mutex> lock(ioLatch);
+					if (!freeRuns.empty()) {
+						int k = freeRuns.back();
+						runs[k] = run;
+						if (fileManager->submitReadPages(run.fileID, run.pageID, runs[k].iov, run.n, k)) {
+							freeRuns.pop_back();
+							break;
+						}
+					}
+				}
+				_complete(true);
+			}
+		}
+		for (int i = 0; i < run.n; ++ i) {
+			unpin(run.index[i]);
+		}
+		run.n = 0;
+	}
+	/*
+	 * 前台访问中fetchPage没有取得页面之后调用，调用者不能持有任何分片的latch
+	 * victim为fetchPage选中的脏页时将其写回，否则分片中所有页面都被固定，只能扩大缓存
+	 * failed为调用者连续写回失败的次数，达到缓存页面个数时也扩大缓存，写失败的页面仍是脏页，由commit报告错误
+	 */
+	void _makeRoom(int victim, int seen, int& failed) {
+		if (victim != -1) {
+			if (_writeVictim(victim) == 0) {
+				failed = 0;
+				return;
+			}
+			if (++ failed < seen) {
+				return;
+			}
+		}
+		failed = 0;
+		_grow(seen);
+	}
+	/*
+	 * 写回被替换算法选中的脏页并唤醒写回线程，调用者不能持有任何分片的latch
+	 * 写失败的页面仍是脏页，留在缓存中，并标记为刚被访问，下一次选择其他页面替换
+	 * 返回:成功操作返回0，写失败时返回-1
+	 */
+	int _writeVictim(int index) {
+		BufShard& s = frameShard(index);
+		std::vector<DirtyPage> pages;
+		flushCv.notify_one();
+		{
+			std::lock_guard<std::recursive_mutex> lock(s.latch);
+			_claim(index, pages);
+		}
+		if (flushRuns(pages) == 0) {
+			return 0;
+		}
+		std::lock_guard<std::recursive_mutex> lock(s.latch);
+		s.replace->access(local(index));
+		return -1;
+	}
+	/*
+	 * 缓存页面个数仍为seen时扩大缓存，调用者不能持有任何分片的latch
+	 * 这会超出设定的缓存大小，并且不会自动缩回，所以打印提示
+	 */
+	void _grow(int seen) {
+		lockAll();
+		if (CAP_ == seen && _resize(seen + seen / 2 + 1)) {
+			std::cout << "Warning! No buffer page can be replaced, the buffer grows from " << seen << " to " << CAP_ << " pages." << std::endl;
+		}
+		unlockAll();
+	}
+	void lockAll() {
+		for (int i = 0; i < shardNum; ++ i) {
+			shards[i].latch.lock();
+		}
+	}
+	void unlockAll() {
+		for (int i = shardNum - 1; i >= 0; -- i) {
+			shards[i].latch.unlock();
+		}
+	}
+	void _submit(int fileID, int pageID, BufType buf, int index, bool isWrite) {
+		while (true) {
+			{
+				std::lock_guard<std::mutex> lock(ioLatch);
+				if (isWrite ? fileManager->submitWritePage(fileID, pageID, buf, index) : fileManager->submitReadPage(fileID, pageID, buf, index)) {
+					return;
+				}
+			}
+			_complete(true);
+		}
+	}
+	void _push() {
+		std::lock_guard<std::mutex> lock(ioLatch);
+		fileManager->pushPages();
+	}
+	/*
+	 * _complete和_waitFor只需要ioLatch，可以在持有或不持有分片latch时调用
+	 */
+	int _complete(bool wait) {
+		IORequest done[IO_QUEUE_DEPTH];
+		std::lock_guard<std::mutex> lock(ioLatch);
+		int n = fileManager->reapPages(done, IO_QUEUE_DEPTH, wait);
+		for (int i = 0; i < n; ++ i) {
+			onComplete(done[i]);
+		}
+		return n;
+	}
+	void _waitFor(int index) {
+		while (pending[index]) {
+			if (_complete(true) == 0) {
+				// 页面可能正在被另一个线程同步读入
+				std::this_thread::yield();
+			}
+		}
+	}
+	/*
+	 * useOnce为true时只提示替换算法访问了一次，用于顺序扫描，页面不会因此进入保护队列
+	 * 提示属于这一次访问，之后对同一页面的普通访问照常提升页面
+	 */
+	void _access(int index, bool useOnce = false) {
+		BufShard& s = frameShard(index);
+		int l = local(index);
+		if (l == s.last) {
+			return;
+		}
+		if (useOnce) {
+			s.replace->accessOnce(l);
+		} else {
+			s.replace->access(l);
+			s.last = l;
+		}
+	}
+	void _getKeys(int index, int& fileID, int& pageID) {
+		frameShard(index).hash->getKeys(local(index), fileID, pageID);
+	}
+	/*
+	 * 归还干净且没有被固定的页面，返回是否归还
+	 * 脏页由调用者先在不持有分片latch时用flushRuns写回，写失败的页面仍是脏页，留在缓存中
+	 */
+	bool _unmapClean(int index) {
+		_waitFor(index);
+		if (dirty[index] || pins[index] > 0) {
+			return false;
+		}
+		_unmap(index);
+		return true;
+	}
+	/*
+	 * 被固定的页面也立即移出hash表，文件id之后可以分配给别的文件
+	 * 这样的页面不再被标记为脏页，最后一次解除固定时交给替换算法
+	 */
+	void _release(int index) {
+		_waitFor(index);
+		dirty[index] = false;
+		_unmap(index);
+	}
+	bool _mapped(int index) {
+		int f, p;
+		_getKeys(index, f, p);
+		return f != -1;
+	}
+	void _unmap(int index) {
+		BufShard& s = frameShard(index);
+		readFailed[index] = false;
+		s.replace->free(local(index));
+		s.hash->remove(local(index));
+		std::lock_guard<std::mutex> lock(fileLatch);
+		bpl->del(index);
+	}
+	/*
+	 * 文件fileID在缓存中的页面下标，不需要持有分片的latch
+	 * 返回之后页面可能被替换，调用者在分片的latch下用_owns确认
+	 */
+	void _filePages(int fileID, std::vector<int>& indices) {
+		std::lock_guard<std::mutex> lock(fileLatch);
+		for (int p = bpl->getFirst(fileID); !bpl->isHead(p); p = bpl->next(p)) {
+			indices.push_back(p);
+		}
+	}
+	bool _owns(int index, int fileID) {
+		if (index >= CAP_) {
+			return false;
+		}
+		int f, p;
+		_getKeys(index, f, p);
+		return f == fileID;
+	}
+	bool _submitWrite(int index) {
+		if (!dirty[index] || pending[index]) {
+			return false;
+		}
+		int f, p;
+		_getKeys(index, f, p);
+		dirty[index] = false;
+		pending[index] = true;
+		_submit(f, p, addr[index], index, true);
+		return true;
+	}
+	/*
+	 * 如果页面是脏页，取走脏页标记并固定页面，放入pages等待flushRuns写回
+	 */
+	void _claim(int index, std::vector<DirtyPage>& pages) {
+		_waitFor(index);
+		if (!dirty[index]) {
+			return;
+		}
+		DirtyPage d;
+		_getKeys(index, d.fileID, d.pageID);
+		d.index = index;
+		d.buf = addr[index];
+		dirty[index] = false;
+		++ pins[index];
+		pages.push_back(d);
+	}
+	/*
+	 * 将每个分片中替换算法最先替换的页面中的脏页按(文件号,页号)的顺序提交异步写
+	 * 之后替换这些页面时不需要同步写回
+	 * 被固定的页面可能正在被修改，跳过；没有被固定的页面在写完之前不会交给调用者
+	 */
+	void flushCold() {
+		_complete(false);
+		int scan = std::max(1, FLUSH_SCAN_PAGES / shardNum);
+		int batch = std::max(1, FLUSH_BATCH_PAGES / shardNum);
+		std::vector<int> cold(scan);
+		bool issued = false;
+		for (int i = 0; i < shardNum; ++ i) {
+			BufShard& s = shards[i];
+			std::lock_guard<std::recursive_mutex> lock(s.latch);
+			int n = s.replace->coldest(&cold[0], scan);
+			std::vector<DirtyPage> pages;
+			for (int j = 0; j < n && (int) pages.size() < batch; ++ j) {
+				int index = global(s, cold[j]);
+				if (dirty[index] && !pending[index] && pins[index] == 0) {
+					DirtyPage d;
+					_getKeys(index, d.fileID, d.pageID);
+					d.index = index;
+					pages.push_back(d);
+				}
+			}
+			std::sort(pages.begin(), pages.end());
+			for (size_t j = 0; j < pages.size(); ++ j) {
+				issued |= _submitWrite(pages[j].index);
+			}
+		}
+		if (issued) {
+			_push();
+		}
+	}
+	void flusherMain() {
+		std::unique_lock<std::mutex> lk(flushMutex);
+		while (!flushStop) {
+			flushCv.wait_for(lk, std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+			if (flushStop) {
+				break;
+			}
+			lk.unlock();
+			flushCold();
+			lk.lock();
+		}
+	}
+	void onComplete(const IORequest& r) {
+		if (r.iov != NULL) {
+			ReadRun& run = runs[r.tag];
+			for (int i = 0; i < run.n; ++ i) {
+				if (r.result != 0) {
+					readFailed[run.index[i]] = true;
+				}
+				pending[run.index[i]] = false;
+			}
+			freeRuns.push_back(r.tag);
+			return;
+		}
+		if (r.result != 0) {
+			if (r.isWrite) {
+				dirty[r.tag] = true;
+				dirtied = true;
+			} else {
+				readFailed[r.tag] = true;
+			}
+		}
+		pending[r.tag] = false;
+	}
+	/*
+	 * 将_claim取走的脏页按(文件号,页号)排序后写回，文件中相邻的页面合并为一次系统调用
+	 * 写回时不持有分片的latch，但对页面加读锁，不会写出修改了一半的页面
+	 * 写回后解除固定，写失败的页面重新标记为脏页
+	 * 返回:成功操作返回0，有页面写失败时返回-1
+	 */
+	int flushRuns(std::vector<DirtyPage>& pages) {
+		std::sort(pages.begin(), pages.end());
+		std::vector<bool> failed(pages.size(), false);
+		BufType bufs[IO_RUN_PAGES];
+		size_t i = 0;
+		while (i < pages.size()) {
+			size_t first = i;
+			int f = pages[i].fileID;
+			int start = pages[i].pageID;
+			int cnt = 0;
+			while (i < pages.size() && cnt < IO_RUN_PAGES && pages[i].fileID == f && pages[i].pageID == start + cnt) {
+				latchPage(pages[i].index, LATCH_SHARED);
+				bufs[cnt++] = pages[i].buf;
+				++ i;
+			}
+			bool ok = (fileManager->writePages(f, start, bufs, cnt) == 0);
+			for (size_t j = first; j < i; ++ j) {
+				unlatchPage(pages[j].index);
+				failed[j] = !ok;
+			}
+		}
+		bool allOk = true;
+		for (i = 0; i < pages.size(); ++ i) {
+			BufShard& s = frameShard(pages[i].index);
+			std::lock_guard<std::recursive_mutex> lock(s.latch);
+			if (failed[i]) {
+				dirty[pages[i].index] = true;
+				dirtied = true;
+				allOk = false;
+			}
+			-- pins[pages[i].index];
+		}
+		return allOk ? 0 : -1;
+	}
+	/*
+	 * 取走所有脏页，调用者不能持有分片的latch，resize除外
+	 */
+	void claimAll(std::vector<DirtyPage>& pages) {
+		for (int i = 0; i < shardNum; ++ i) {
+			BufShard& s = shards[i];
+			std::lock_guard<std::recursive_mutex> lock(s.latch);
+			for (int l = 0; l < s.cap; ++ l) {
+				_claim(global(s, l), pages);
+			}
+		}
+	}
+	/*
+	 * 要求调用者按顺序持有所有分片的latch
+	 */
+	bool _resize(int c) {
+		if (c < shardNum || c == CAP_) {
+			return false;
+		}
+		for (int i = c; i < CAP_; ++ i) {
+			if (pins[i] > 0) {
+				return false;
+			}
+		}
+		FrameArena* arena = NULL;
+		if (c > CAP_) {
+			arena = allocArena(CAP_, c - CAP_);
+			if (arena == NULL) {
+				return false;
+			}
+		}
+		for (int i = 0; i < CAP_; ++ i) {
+			_waitFor(i);
+		}
+		std::vector<DirtyPage> pages;
+		for (int i = c; i < CAP_; ++ i) {
+			_claim(i, pages);
+		}
+		if (flushRuns(pages) != 0) {
+			return false;
+		}
+		for (int i = c; i < CAP_; ++ i) {
+			_unmapClean(i);
+			pthread_rwlock_destroy(frameLatch[i]);
+			delete frameLatch[i];
+		}
+		std::lock_guard<std::mutex> io(ioLatch);
+		std::lock_guard<std::mutex> files(fileLatch);
+		std::atomic<bool>* d = new std::atomic<bool>[c];
+		std::atomic<bool>* pd = new std::atomic<bool>[c];
+		std::atomic<bool>* rf = new std::atomic<bool>[c];
+		int* pn = new int[c];
+		BufType* ad = new BufType[c];
+		pthread_rwlock_t** fl = new pthread_rwlock_t*[c];
+		for (int i = 0; i < c; ++ i) {
+			d[i] = (i < CAP_) ? dirty[i].load() : false;
+			pd[i] = false;
+			rf[i] = (i < CAP_) ? readFailed[i].load() : false;
+			pn[i] = (i < CAP_) ? pins[i] : 0;
+			ad[i] = (i < CAP_) ? addr[i] : arena->frame(i - CAP_);
+			if (i < CAP_) {
+				fl[i] = frameLatch[i];
+			} else {
+				fl[i] = new pthread_rwlock_t;
+				pthread_rwlock_init(fl[i], NULL);
+			}
+		}
+		delete[] dirty;
+		delete[] pending;
+		delete[] readFailed;
+		delete[] pins;
+		delete[] addr;
+		delete[] frameLatch;
+		if (c < CAP_) {
+			freeArenas(c);
+		}
+		dirty = d;
+		pending = pd;
+		readFailed = rf;
+		pins = pn;
+		addr = ad;
+		frameLatch = fl;
+		for (int i = 0; i < shardNum; ++ i) {
+			BufShard& s = shards[i];
+			s.cap = shardCap(i, c);
+			s.hash->resize(s.cap);
+			s.replace->resize(s.cap);
+			if (s.last >= s.cap) {
+				s.last = -1;
+			}
+		}
+		CAP_ = c;
+		delete bpl;
+		bpl = new MyLinkList(c, MAX_FILE_NUM);
+		for (int i = 0; i < c; ++ i) {
+			int f, p;
+			_getKeys(i, f, p);
+			if (f != -1) {
+				bpl->insert(f, i);
+			}
+		}
+		return true;
+	}
 public:
 	/*
 	 * @函数名allocPage
@@ -58,11 +866,29 @@ public:
 	 *           如果确信指定的文件页面不在缓存中，那么就不用在hash表中进行查找，直接调用替换算法，节省时间
 	 */
 	BufType allocPage(int fileID, int pageID, int& index, bool ifRead = false) {
-		BufType b = fetchPage(fileID, pageID, index);
-		if (ifRead) {
-			fileManager->readPage(fileID, pageID, b, 0);
+		BufShard& s = shardOf(fileID, pageID);
+		int failed = 0;
+		while (true) {
+			int seen;
+			BufType b;
+			{
+				std::lock_guard<std::recursive_mutex> lock(s.latch);
+				if (!ifRead) {
+					b = fetchPage(s, fileID, pageID, index);
+					if (b != NULL) {
+						return b;
+					}
+				} else {
+					b = _startRead(s, fileID, pageID, index);
+				}
+				seen = CAP_;
+			}
+			if (b != NULL) {
+				_finishRead(fileID, pageID, index, false);
+				return b;
+			}
+			_makeRoom(index, seen, failed);
 		}
-		return b;
 	}
 	/*
 	 * @函数名getPage
@@ -76,16 +902,149 @@ public:
 	 *           首先，在hash表中查找(fileID,pageID)对应的缓存页面，
 	 *           如果能找到，那么表示文件页面在缓存中
 	 *           如果没有找到，那么就利用替换算法获取一个页面
+	 * 注意:多个线程同时使用缓存时，返回的页面可能随时被替换，应当使用pinPage
 	 */
 	BufType getPage(int fileID, int pageID, int& index) {
-		index = hash->findIndex(fileID, pageID);
-		if (index != -1) {
-			access(index);
-			return addr[index];
+		return _getPage(fileID, pageID, index, false);
+	}
+	/*
+	 * @函数名pinPage
+	 * @参数useOnce:这次访问是否来自顺序扫描，是时只提示替换算法访问了一次
+	 * 功能:同getPage，并在返回之前固定页面，之后需要调用unpin
+	 *           查找和固定在分片的latch下完成，中间页面不会被其他线程替换
+	 */
+	BufType pinPage(int fileID, int pageID, int& index, bool useOnce = false) {
+		return _getPage(fileID, pageID, index, true, useOnce);
+	}
+	/*
+	 * @函数名findPage
+	 * @参数fileID:文件id
+	 * @参数pageID:文件页号
+	 * 返回:文件页面在缓存页面数组中的下标，不在缓存中时返回-1
+	 */
+	int findPage(int fileID, int pageID) {
+		BufShard& s = shardOf(fileID, pageID);
+		std::lock_guard<std::recursive_mutex> lock(s.latch);
+		return _find(s, fileID, pageID);
+	}
+	/*
+	 * @函数名prefetchPage
+	 * @参数fileID:文件id
+	 * @参数pageID:文件页号
+	 * 功能:为文件页分配一个缓存页面并提交异步读请求，立即返回
+	 *           之后对该页面的getPage会等待读请求完成
+	 * 返回:页面已经在缓存中时返回false
+	 */
+	bool prefetchPage(int fileID, int pageID) {
+		bool issued = _prefetch(fileID, pageID);
+		_push();
+		return issued;
+	}
+	/*
+	 * @函数名readSequential
+	 * @参数ra:扫描的预读状态
+	 * @参数fileID:文件id
+	 * @参数first:扫描的第一个文件页号
+	 * @参数end:扫描结束的文件页号(不含)
+	 * 功能:声明一次顺序扫描，之后扫描每进入一个新页面时调用readAhead
+	 */
+	void readSequential(ReadAhead& ra, int fileID, int first, int end) {
+		ra.fileID = fileID;
+		ra.sequential = true;
+		ra.next = first;
+		ra.end = end;
+		ra.pages.clear();
+		ra.pos = 0;
+	}
+	/*
+	 * @函数名readList
+	 * @参数ra:扫描的预读状态
+	 * @参数fileID:文件id
+	 * @参数pages:接下来将要依次访问的文件页号，例如索引叶节点链上的后续节点
+	 * 功能:声明一串将要访问的页面，之后每访问pages中的一项时调用readAhead
+	 */
+	void readList(ReadAhead& ra, int fileID, const std::vector<int>& pages) {
+		ra.fileID = fileID;
+		ra.sequential = false;
+		ra.pages = pages;
+		ra.pos = 0;
+	}
+	/*
+	 * @函数名readAhead
+	 * @参数ra:扫描的预读状态
+	 * @参数current:顺序模式下为即将访问的文件页号，列表模式下为即将访问的页面在pages中的下标
+	 * 功能:保证current之后READ_AHEAD_PAGES个页面的异步读已经发出
+	 *           已发出的预读不足窗口一半时才补发，补发的请求一次交给内核
+	 *           文件中相邻的页面合并为一个向量读请求，每IO_RUN_PAGES个页面只需一次读
+	 *           ra属于调用者，每个扫描使用自己的ra时多个线程可以同时调用
+	 */
+	void readAhead(ReadAhead& ra, int current) {
+		if (ra.fileID < 0) {
+			return;
+		}
+		int issued = 0;
+		if (ra.sequential) {
+			if (ra.next < current) {
+				ra.next = current;
+			}
+			int limit = std::min(ra.end, current + READ_AHEAD_PAGES);
+			if (ra.next - current > READ_AHEAD_PAGES / 2) {
+				return;
+			}
+			int pages[READ_AHEAD_PAGES];
+			int n = 0;
+			for (; ra.next < limit; ++ ra.next) {
+				pages[n++] = ra.next;
+			}
+			issued = _prefetchPages(ra.fileID, pages, n);
 		} else {
-			BufType b = fetchPage(fileID, pageID, index);
-			fileManager->readPage(fileID, pageID, b, 0);
-			return b;
+			if (ra.pos < (size_t) current) {
+				ra.pos = current;
+			}
+			size_t limit = std::min(ra.pages.size(), (size_t) current + READ_AHEAD_PAGES);
+			if (ra.pos - current > READ_AHEAD_PAGES / 2) {
+				return;
+			}
+			if (ra.pos < limit) {
+				issued = _prefetchPages(ra.fileID, &ra.pages[ra.pos], limit - ra.pos);
+				ra.pos = limit;
+			}
+		}
+		if (issued > 0) {
+			_push();
+		}
+	}
+	/*
+	 * @函数名complete
+	 * @参数wait:没有已完成的请求时是否阻塞等待
+	 * 功能:取回已经完成的异步读写请求，更新对应缓存页面的状态
+	 * 返回:完成的请求个数
+	 */
+	int complete(bool wait) {
+		return _complete(wait);
+	}
+	/*
+	 * @函数名waitFor
+	 * @参数index:缓存页面数组中的下标
+	 * 功能:等待index代表的缓存页面上的异步读写完成
+	 */
+	void waitFor(int index) {
+		std::lock_guard<std::recursive_mutex> lock(frameShard(index).latch);
+		_waitFor(index);
+	}
+	/*
+	 * @函数名drain
+	 * 功能:等待所有在途的异步读写完成
+	 */
+	void drain() {
+		while (true) {
+			{
+				std::lock_guard<std::mutex> lock(ioLatch);
+				if (fileManager->pagesInFlight() == 0) {
+					return;
+				}
+			}
+			_complete(true);
 		}
 	}
 	/*
@@ -94,11 +1053,8 @@ public:
 	 * 功能:标记index代表的缓存页面被访问过，为替换算法提供信息
 	 */
 	void access(int index) {
-		if (index == last) {
-			return;
-		}
-		replace->access(index);
-		last = index;
+		std::lock_guard<std::recursive_mutex> lock(frameShard(index).latch);
+		_access(index);
 	}
 	/*
 	 * @函数名markDirty
@@ -107,42 +1063,240 @@ public:
 	 *           保证数据的正确性
 	 */
 	void markDirty(int index) {
+		std::lock_guard<std::recursive_mutex> lock(frameShard(index).latch);
+		if (!_mapped(index)) {
+			return;
+		}
 		dirty[index] = true;
-		access(index);
+		dirtied = true;
+		_access(index);
+	}
+	/*
+	 * @函数名pin
+	 * @参数index:缓存页面数组中的下标，用来表示一个缓存页面
+	 * 功能:固定index代表的缓存页面，在对应的unpin之前页面不会被替换，也不会被writeBack和close归还
+	 *           通常通过PageGuard使用
+	 */
+	void pin(int index) {
+		std::lock_guard<std::recursive_mutex> lock(frameShard(index).latch);
+		++ pins[index];
+	}
+	/*
+	 * @函数名unpin
+	 * @参数index:缓存页面数组中的下标，用来表示一个缓存页面
+	 * 功能:解除一次pin，被固定时归还的页面在最后一次解除固定时交给替换算法
+	 */
+	void unpin(int index) {
+		BufShard& s = frameShard(index);
+		std::lock_guard<std::recursive_mutex> lock(s.latch);
+		if (-- pins[index] == 0 && !_mapped(index)) {
+			s.replace->free(local(index));
+		}
+	}
+	/*
+	 * @函数名latchPage
+	 * @参数index:缓存页面数组中的下标，页面必须已经被固定
+	 * @参数mode:LATCH_SHARED为读锁，LATCH_EXCLUSIVE为写锁
+	 * 功能:对页面的内容加锁，阻塞到加锁成功为止，通常通过PageGuard使用
+	 */
+	void latchPage(int index, PageLatch mode) {
+		pthread_rwlock_t* l;
+		{
+			std::lock_guard<std::recursive_mutex> lock(frameShard(index).latch);
+			l = frameLatch[index];
+		}
+		if (mode == LATCH_SHARED) {
+			pthread_rwlock_rdlock(l);
+		} else if (mode == LATCH_EXCLUSIVE) {
+			pthread_rwlock_wrlock(l);
+		}
+	}
+	/*
+	 * @函数名unlatchPage
+	 * @参数index:缓存页面数组中的下标
+	 * 功能:释放latchPage加的锁
+	 */
+	void unlatchPage(int index) {
+		pthread_rwlock_t* l;
+		{
+			std::lock_guard<std::recursive_mutex> lock(frameShard(index).latch);
+			l = frameLatch[index];
+		}
+		pthread_rwlock_unlock(l);
 	}
 	/*
 	 * @函数名release
 	 * @参数index:缓存页面数组中的下标，用来表示一个缓存页面
 	 * 功能:将index代表的缓存页面归还给缓存管理器，在归还前，缓存页面中的数据不标记写回
+	 *           被固定的页面也立即归还，固定者之后的修改被丢弃
 	 */
 	void release(int index) {
-		dirty[index] = false;
-		replace->free(index);
-		hash->remove(index);
+		std::lock_guard<std::recursive_mutex> lock(frameShard(index).latch);
+		_release(index);
 	}
 	/*
 	 * @函数名writeBack
 	 * @参数index:缓存页面数组中的下标，用来表示一个缓存页面
 	 * 功能:将index代表的缓存页面归还给缓存管理器，在归还前，缓存页面中的数据需要根据脏页标记决定是否写到对应的文件页面中
+	 *           被固定的页面只写回，不归还，写失败的页面仍是脏页，留在缓存中
+	 * 返回:成功操作返回0，写失败时返回-1
 	 */
-	void writeBack(int index) {
-		if (dirty[index]) {
-			int f, p;
-			hash->getKeys(index, f, p);
-			fileManager->writePage(f, p, addr[index], 0);
-			dirty[index] = false;
+	int writeBack(int index) {
+		std::vector<DirtyPage> pages;
+		{
+			std::lock_guard<std::recursive_mutex> lock(frameShard(index).latch);
+			_claim(index, pages);
+		}
+		int ret = flushRuns(pages);
+		std::lock_guard<std::recursive_mutex> lock(frameShard(index).latch);
+		_unmapClean(index);
+		return ret;
+	}
+	/*
+	 * @函数名flushFile
+	 * @参数fileID:文件id
+	 * 功能:将fileID对应文件在缓存中的脏页全部写回，页面仍然留在缓存中
+	 * 返回:成功操作返回0，有页面写失败时返回-1
+	 */
+	int flushFile(int fileID) {
+		std::vector<int> indices;
+		std::vector<DirtyPage> pages;
+		_filePages(fileID, indices);
+		for (size_t i = 0; i < indices.size(); ++ i) {
+			std::lock_guard<std::recursive_mutex> lock(frameShard(indices[i]).latch);
+			if (_owns(indices[i], fileID)) {
+				_claim(indices[i], pages);
+			}
 		}
-		replace->free(index);
-		hash->remove(index);
+		return flushRuns(pages);
+	}
+	/*
+	 * @函数名closeFile
+	 * @参数fileID:文件id
+	 * 功能:将fileID对应文件在缓存中的页面写回后全部归还，其他文件的页面不受影响
+	 *           关闭文件之前调用，之后文件id可以分配给别的文件
+	 *           有页面写失败时这些页面仍是脏页，调用者应当用dropFile丢弃后才能关闭文件
+	 * 返回:成功操作返回0，有页面写失败时返回-1
+	 */
+	int closeFile(int fileID) {
+		int ret = flushFile(fileID);
+		std::vector<int> indices;
+		_filePages(fileID, indices);
+		for (size_t i = 0; i < indices.size(); ++ i) {
+			std::lock_guard<std::recursive_mutex> lock(frameShard(indices[i]).latch);
+			if (_owns(indices[i], fileID)) {
+				_unmapClean(indices[i]);
+			}
+		}
+		return ret;
+	}
+	/*
+	 * @函数名dropFile
+	 * @参数fileID:文件id
+	 * 功能:不写回，直接归还fileID对应文件在缓存中的所有页面，用于文件被删除的情况
+	 *           被固定的页面也立即归还，之后文件id可以分配给别的文件
+	 */
+	void dropFile(int fileID) {
+		std::vector<int> indices;
+		_filePages(fileID, indices);
+		for (size_t i = 0; i < indices.size(); ++ i) {
+			std::lock_guard<std::recursive_mutex> lock(frameShard(indices[i]).latch);
+			if (_owns(indices[i], fileID)) {
+				_release(indices[i]);
+			}
+		}
+	}
+	/*
+	 * @函数名mapFile
+	 * @参数fileID:文件id
+	 * @参数pageNum:映射的页面个数
+	 * 功能:写回文件的脏页后将文件只读映射到内存中，供只读扫描绕过缓存直接访问
+	 * 返回:映射的首地址，失败时返回NULL，调用者应退回到getPage
+	 */
+	BufType mapFile(int fileID, int pageNum) {
+		if (flushFile(fileID) != 0) {
+			return NULL;
+		}
+		return fileManager->mapFile(fileID, pageNum);
+	}
+	void unmapFile(BufType base, int pageNum) {
+		fileManager->unmapFile(base, pageNum);
 	}
 	/*
 	 * @函数名close
 	 * 功能:将所有缓存页面归还给缓存管理器，归还前需要根据脏页标记决定是否写到对应的文件页面中
+	 *           被固定的页面只写回，不归还，写失败的页面仍是脏页，留在缓存中
+	 * 返回:成功操作返回0，有页面写失败时返回-1
+	 */
+	int close() {
+		drain();
+		std::vector<DirtyPage> pages;
+		claimAll(pages);
+		int ret = flushRuns(pages);
+		for (int i = 0; i < shardNum; ++ i) {
+			BufShard& s = shards[i];
+			std::lock_guard<std::recursive_mutex> lock(s.latch);
+			for (int l = 0; l < s.cap; ++ l) {
+				_unmapClean(global(s, l));
+			}
+		}
+		return ret;
+	}
+	/*
+	 * @函数名commit
+	 * 功能:将所有脏页写回，再用文件管理器的syncBarrier等待写过的文件落盘，页面仍然留在缓存中
+	 *           每条语句结束时调用，多个会话同时提交时共用一次落盘
+	 *           上次提交之后没有页面被标记为脏页时不扫描缓存页面
+	 * 返回:成功操作返回0，有页面写回或落盘失败时返回-1
+	 */
+	int commit() {
+		drain();
+		int written = 0;
+		if (dirtied.exchange(false)) {
+			std::vector<DirtyPage> pages;
+			claimAll(pages);
+			written = flushRuns(pages);
+		}
+		int synced = fileManager->syncBarrier();
+		return (written == 0 && synced == 0) ? 0 : -1;
+	}
+	/*
+	 * @函数名checkpoint
+	 * 功能:同commit，用于没有按语句提交时定期或退出前调用
+	 */
+	int checkpoint() {
+		return commit();
+	}
+	/*
+	 * @函数名startFlusher
+	 * 功能:启动后台写回线程，每FLUSH_INTERVAL_MS毫秒把即将被替换的脏页写回，
+	 *           使替换时通常不需要同步写回
+	 *           环境变量MINISQL_FLUSHER为off时不启动
+	 * 返回:是否启动了写回线程
+	 */
+	bool startFlusher() {
+		const char* env = getenv("MINISQL_FLUSHER");
+		if (flusher.joinable() || (env != NULL && strcmp(env, "off") == 0)) {
+			return false;
+		}
+		flushStop = false;
+		flusher = std::thread(&BufPageManager::flusherMain, this);
+		return true;
+	}
+	/*
+	 * @函数名stopFlusher
+	 * 功能:停止后台写回线程
 	 */
-	void close() {
-		for (int i = 0; i < CAP; ++ i) {
-			writeBack(i);
+	void stopFlusher() {
+		if (!flusher.joinable()) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lk(flushMutex);
+			flushStop = true;
 		}
+		flushCv.notify_one();
+		flusher.join();
 	}
 	/*
 	 * @函数名getKey
@@ -151,25 +1305,103 @@ public:
 	 * @参数pageID:函数返回时，用于存储指定缓存页面对应的文件页号
 	 */
 	void getKey(int index, int& fileID, int& pageID) {
-		hash->getKeys(index, fileID, pageID);
+		std::lock_guard<std::recursive_mutex> lock(frameShard(index).latch);
+		_getKeys(index, fileID, pageID);
+	}
+	/*
+	 * @函数名replacerName
+	 * 返回:各个分片使用的替换算法的名字
+	 */
+	const char* replacerName() {
+		return shards[0].replace->name();
+	}
+	/*
+	 * @函数名resize
+	 * @参数c:新的缓存页面个数，不能小于分片个数
+	 * 功能:在运行时扩大或缩小缓存，新增的缓存页面最先被使用
+	 *           缩小时，下标不小于c的页面先写回再归还，调用者不能再持有这些页面的下标
+	 *           调用者不能持有任何页面的闩锁
+	 * 返回:是否改变了缓存大小，下标不小于c的页面中有被固定的页面时不能缩小
+	 */
+	bool resize(int c) {
+		lockAll();
+		bool ok = _resize(c);
+		unlockAll();
+		return ok;
+	}
+	/*
+	 * @函数名defaultCapacity
+	 * 返回:环境变量MINISQL_BUFFER_PAGES指定的缓存页面个数，没有指定时为CAP
+	 */
+	static int defaultCapacity() {
+		const char* env = getenv("MINISQL_BUFFER_PAGES");
+		int c = (env != NULL) ? atoi(env) : 0;
+		return (c > 0) ? c : CAP;
+	}
+	/*
+	 * @函数名newReplacer
+	 * @参数c:缓存页面个数
+	 * 返回:环境变量MINISQL_REPLACER指定的替换算法，lru为栈式LRU，默认为2q
+	 */
+	static Replacer* newReplacer(int c) {
+		const char* env = getenv("MINISQL_REPLACER");
+		if (env != NULL && strcmp(env, "lru") == 0) {
+			return new FindReplace(c);
+		}
+		return new TwoQReplace(c);
 	}
 	/*
 	 * 构造函数
 	 * @参数fm:文件管理器，缓存管理器需要利用文件管理器与磁盘进行交互
+	 * @参数c:缓存页面个数，不大于0时使用defaultCapacity
+	 *           每BUF_SHARD_MIN_PAGES个页面一个分片，最多BUF_SHARD_NUM个分片，分片个数之后不再改变
 	 */
-	BufPageManager(FileManager* fm) {
-		int c = CAP;
-		int m = MOD;
-		last = -1;
+	BufPageManager(FileManager* fm, int c = 0) {
+		if (c <= 0) {
+			c = defaultCapacity();
+		}
+		CAP_ = c;
+		shardNum = std::max(1, std::min(BUF_SHARD_NUM, c / BUF_SHARD_MIN_PAGES));
+		shards = new BufShard[shardNum];
+		for (int i = 0; i < shardNum; ++ i) {
+			shards[i].id = i;
+			shards[i].cap = shardCap(i, c);
+			shards[i].last = -1;
+			shards[i].hash = new MyHashMap(shards[i].cap);
+			shards[i].replace = newReplacer(shards[i].cap);
+		}
+		flushStop = false;
+		dirtied = false;
 		fileManager = fm;
-		//bpl = new MyLinkList(CAP, MAX_FILE_NUM);
-		dirty = new bool[CAP];
-		addr = new BufType[CAP];
-		hash = new MyHashMap(c, m);
-	    replace = new FindReplace(c);
-		for (int i = 0; i < CAP; ++ i) {
+		bpl = new MyLinkList(c, MAX_FILE_NUM);
+		dirty = new std::atomic<bool>[c];
+		pending = new std::atomic<bool>[c];
+		readFailed = new std::atomic<bool>[c];
+		pins = new int[c];
+		addr = new BufType[c];
+		frameLatch = new pthread_rwlock_t*[c];
+		FrameArena* arena = allocArena(0, c);
+		if (arena == NULL) {
+			throw std::bad_alloc();
+		}
+		for (int i = 0; i < c; ++ i) {
 			dirty[i] = false;
-			addr[i] = NULL;
+			pending[i] = false;
+			readFailed[i] = false;
+			pins[i] = 0;
+			addr[i] = arena->frame(i);
+			frameLatch[i] = new pthread_rwlock_t;
+			pthread_rwlock_init(frameLatch[i], NULL);
+		}
+		runs.resize(IO_QUEUE_DEPTH);
+		for (int i = IO_QUEUE_DEPTH - 1; i >= 0; -- i) {
+			freeRuns.push_back(i);
+		}
+	}
+	~BufPageManager() {
+		stopFlusher();
+		for (size_t i = 0; i < arenas.size(); ++ i) {
+			delete arenas[i];
 		}
 	}
 };
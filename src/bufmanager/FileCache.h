@@ -0,0 +1,117 @@
+#ifndef FILE_CACHE
+#define FILE_CACHE
+#include <string>
+#include <map>
+#include "../fileio/FileManager.h"
+#include "BufPageManager.h"
+/*
+ * FileCache
+ * 记录管理器和索引管理器关闭文件时，文件并不真正关闭，而是连同它在缓存中的页面一起留在这里
+ * 下一次打开同一个文件时直接复用，热数据在语句之间一直留在缓存中
+ * 留下的文件超过上限时，关闭最久没有使用的文件
+ */
+class FileCache {
+private:
+	FileManager* fm;
+	BufPageManager* bpm;
+	int limit;
+	long long tick;
+	/*
+	 * 文件名到(文件id,最近一次放入的时间)
+	 */
+	std::map<std::string, std::pair<int, long long> > files;
+	void closeEntry(std::map<std::string, std::pair<int, long long> >::iterator it, bool write) {
+		if (write && bpm->closeFile(it->second.first) != 0) {
+			// 写不回的页面不能留在缓存中，文件id之后会分配给别的文件
+			std::cout << "Error! Failed to write back " << it->first << "." << std::endl;
+			write = false;
+		}
+		if (!write) {
+			bpm->dropFile(it->second.first);
+		}
+		fm->closeFile(it->second.first);
+		files.erase(it);
+	}
+public:
+	/*
+	 * @函数名take
+	 * @参数name:文件名
+	 * @参数fileID:函数返回时，如果文件留在这里，存储它的文件id
+	 * 功能:取出留下的文件，取出后由调用者负责
+	 * 返回:文件留在这里时返回true
+	 */
+	bool take(const std::string& name, int& fileID) {
+		auto it = files.find(name);
+		if (it == files.end()) {
+			return false;
+		}
+		fileID = it->second.first;
+		files.erase(it);
+		return true;
+	}
+	/*
+	 * @函数名put
+	 * @参数name:文件名
+	 * @参数fileID:文件id
+	 * 功能:代替关闭文件，文件和它的页面都留在缓存中，脏页由写回线程和commit写回
+	 */
+	void put(const std::string& name, int fileID) {
+		files[name] = std::make_pair(fileID, ++ tick);
+		while ((int) files.size() > limit) {
+			auto oldest = files.begin();
+			for (auto it = files.begin(); it != files.end(); ++ it) {
+				if (it->second.second < oldest->second.second) {
+					oldest = it;
+				}
+			}
+			closeEntry(oldest, true);
+		}
+	}
+	/*
+	 * @函数名drop
+	 * @参数name:文件名
+	 * 功能:文件将被删除或重建，不写回，关闭留下的文件并归还它的缓存页面
+	 */
+	void drop(const std::string& name) {
+		auto it = files.find(name);
+		if (it != files.end()) {
+			closeEntry(it, false);
+		}
+	}
+	/*
+	 * @函数名dropPrefix
+	 * @参数prefix:文件名前缀，例如将被删除的数据库目录
+	 * 功能:对所有以prefix开头的文件执行drop
+	 */
+	void dropPrefix(const std::string& prefix) {
+		auto it = files.begin();
+		while (it != files.end()) {
+			auto cur = it++;
+			if (cur->first.compare(0, prefix.size(), prefix) == 0) {
+				closeEntry(cur, false);
+			}
+		}
+	}
+	/*
+	 * @函数名clear
+	 * 功能:写回并关闭所有留下的文件
+	 */
+	void clear() {
+		while (!files.empty()) {
+			closeEntry(files.begin(), true);
+		}
+	}
+	FileCache() {
+		fm = NULL;
+		bpm = NULL;
+		limit = FILE_CACHE_NUM;
+		tick = 0;
+	}
+	FileCache(FileManager* fm, BufPageManager* bpm) {
+		this->fm = fm;
+		this->bpm = bpm;
+		limit = FILE_CACHE_NUM;
+		tick = 0;
+	}
+};
+#endif
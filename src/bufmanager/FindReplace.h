@@ -3,12 +3,13 @@
 #include "../utils/MyLinkList.h"
 #include "../utils/MyHashMap.h"
 #include "../utils/pagedef.h"
+#include "Replacer.h"
 //template <int CAP_>
 /*
  * FindReplace
- * 提供替换算法接口，这里实现的是栈式LRU算法
+ * 栈式LRU替换算法
  */
-class FindReplace {
+class FindReplace : public Replacer {
 private:
 	MyLinkList* list;
 	int CAP_;
@@ -30,6 +31,14 @@ public:
 	void access(int index) {
 		list->insert(0, index);
 	}
+	/*
+	 * @函数名accessOnce
+	 * @参数index:缓存页面数组中页面的下标
+	 * 功能:将页面放到栈底，下一次替换时首先被选中
+	 */
+	void accessOnce(int index) {
+		list->insertFirst(0, index);
+	}
 	/*
 	 * @函数名find
 	 * 功能:根据替换算法返回缓存页面数组中要被替换页面的下标
@@ -40,6 +49,36 @@ public:
 		list->insert(0, index);
 		return index;
 	}
+	int coldest(int* out, int max) {
+		int n = 0;
+		for (int p = list->getFirst(0); !list->isHead(p) && n < max; p = list->next(p)) {
+			out[n++] = p;
+		}
+		return n;
+	}
+	/*
+	 * @函数名resize
+	 * @参数c:新的缓存页面容量上限
+	 * 功能:新增的页面排在最前面，最先被find返回，其余页面保持原来的顺序
+	 *           缩小时，下标不小于c的页面被丢弃
+	 */
+	void resize(int c) {
+		MyLinkList* l = new MyLinkList(c, 1);
+		for (int i = CAP_; i < c; ++ i) {
+			l->insert(0, i);
+		}
+		for (int p = list->getFirst(0); !list->isHead(p); p = list->next(p)) {
+			if (p < c) {
+				l->insert(0, p);
+			}
+		}
+		delete list;
+		list = l;
+		CAP_ = c;
+	}
+	const char* name() const {
+		return "lru";
+	}
 	/*
 	 * 构造函数
 	 * @参数c:表示缓存页面的容量上限
@@ -51,5 +90,8 @@ public:
 			list->insert(0, i);
 		}
 	}
+	~FindReplace() {
+		delete list;
+	}
 };
 #endif
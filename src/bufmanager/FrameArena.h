@@ -0,0 +1,107 @@
+#ifndef FRAME_ARENA
+#define FRAME_ARENA
+#include "../utils/pagedef.h"
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <string.h>
+/*
+ * FrameArena
+ * 一段连续的内存，存放若干个缓存页面，第i个缓存页面的地址为首地址加上i*PAGE_SIZE
+ * 优先使用MAP_HUGETLB的大页，系统没有预留大页时退回到普通的匿名映射，并建议内核使用透明大页
+ * 首地址至少按FRAME_ALIGN对齐，缓存页面可以直接用于O_DIRECT读写
+ * 环境变量MINISQL_HUGEPAGES为off时不使用大页
+ */
+class FrameArena {
+private:
+	char* base;
+	size_t len;
+	int pages;
+	bool mapped;
+	bool huge;
+	static bool hugeEnabled() {
+		const char* env = getenv("MINISQL_HUGEPAGES");
+		return env == NULL || strcmp(env, "off") != 0;
+	}
+public:
+	/*
+	 * 构造函数
+	 * @参数n:缓存页面个数
+	 * 功能:映射失败时用posix_memalign分配按FRAME_ALIGN对齐的内存，仍然失败时valid返回false
+	 */
+	FrameArena(int n) {
+		pages = n;
+		len = ((size_t) n) << PAGE_SIZE_IDX;
+		base = NULL;
+		mapped = false;
+		huge = false;
+		bool useHuge = hugeEnabled();
+		void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+		if (useHuge) {
+			size_t hugeLen = (len + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+			p = mmap(NULL, hugeLen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (p != MAP_FAILED) {
+				len = hugeLen;
+				huge = true;
+			}
+		}
+#endif
+		if (p == MAP_FAILED) {
+			p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+			if (p != MAP_FAILED && useHuge) {
+				madvise(p, len, MADV_HUGEPAGE);
+			}
+#endif
+		}
+		if (p != MAP_FAILED) {
+			base = (char*) p;
+			mapped = true;
+		} else if (posix_memalign(&p, FRAME_ALIGN, len) == 0) {
+			base = (char*) p;
+		}
+	}
+	~FrameArena() {
+		if (base == NULL) {
+			return;
+		}
+		if (mapped) {
+			munmap(base, len);
+		} else {
+			free(base);
+		}
+	}
+	bool valid() {
+		return base != NULL;
+	}
+	/*
+	 * @函数名isHuge
+	 * 返回:是否使用了MAP_HUGETLB的大页，透明大页由内核决定，不在这里反映
+	 */
+	bool isHuge() {
+		return huge;
+	}
+	int size() {
+		return pages;
+	}
+	/*
+	 * @函数名frame
+	 * @参数i:缓存页面在这段内存中的序号
+	 * 返回:缓存页面的首地址
+	 */
+	BufType frame(int i) {
+		return (BufType) (base + (((size_t) i) << PAGE_SIZE_IDX));
+	}
+	/*
+	 * @函数名discard
+	 * @参数from:第一个缓存页面的序号
+	 * @参数to:最后一个缓存页面的序号加一
+	 * 功能:把这些缓存页面占用的物理内存还给操作系统，地址仍然有效
+	 */
+	void discard(int from, int to) {
+		if (mapped && from < to) {
+			madvise(base + (((size_t) from) << PAGE_SIZE_IDX), ((size_t) (to - from)) << PAGE_SIZE_IDX, MADV_DONTNEED);
+		}
+	}
+};
+#endif
@@ -0,0 +1,120 @@
+#ifndef PAGE_GUARD
+#define PAGE_GUARD
+#include "BufPageManager.h"
+/*
+ * PageGuard
+ * 固定一个缓存页面，在PageGuard析构或release之前，页面的地址一直有效
+ * 调用者可以在这段时间内直接读写缓存页面，不需要把内容复制出来
+ * 多个线程共享缓存时，可以同时对页面加读锁或写锁，在release时释放
+ */
+class PageGuard {
+private:
+	BufPageManager* bpm;
+	int index;
+	BufType buf;
+	PageLatch mode;
+	PageGuard(const PageGuard&);
+	PageGuard& operator=(const PageGuard&);
+public:
+	PageGuard() {
+		bpm = NULL;
+		index = -1;
+		buf = NULL;
+		mode = LATCH_NONE;
+	}
+	/*
+	 * 构造函数
+	 * @参数bpm:缓存管理器
+	 * @参数fileID:文件id
+	 * @参数pageID:文件页号
+	 * @参数mode:固定之后对页面加的锁，默认不加锁
+	 * @参数useOnce:是否为顺序扫描的访问，见pinPage
+	 * 功能:用pinPage取得文件页面并固定
+	 */
+	PageGuard(BufPageManager* bpm, int fileID, int pageID, PageLatch mode = LATCH_NONE, bool useOnce = false) {
+		this->bpm = bpm;
+		this->mode = mode;
+		buf = bpm->pinPage(fileID, pageID, index, useOnce);
+		if (mode != LATCH_NONE) {
+			bpm->latchPage(index, mode);
+		}
+	}
+	PageGuard(PageGuard&& other) {
+		bpm = other.bpm;
+		index = other.index;
+		buf = other.buf;
+		mode = other.mode;
+		other.bpm = NULL;
+		other.buf = NULL;
+		other.index = -1;
+	}
+	PageGuard& operator=(PageGuard&& other) {
+		if (this != &other) {
+			release();
+			bpm = other.bpm;
+			index = other.index;
+			buf = other.buf;
+			mode = other.mode;
+			other.bpm = NULL;
+			other.buf = NULL;
+			other.index = -1;
+		}
+		return *this;
+	}
+	~PageGuard() {
+		release();
+	}
+	BufType data() const {
+		return buf;
+	}
+	int getIndex() const {
+		return index;
+	}
+	bool valid() const {
+		return bpm != NULL;
+	}
+	/*
+	 * @函数名markDirty
+	 * 功能:标记固定的页面被写过
+	 */
+	void markDirty() {
+		bpm->markDirty(index);
+	}
+	/*
+	 * @函数名latch
+	 * @参数mode:LATCH_SHARED为读锁，LATCH_EXCLUSIVE为写锁
+	 * 功能:对已经固定、还没有加锁的页面加锁
+	 */
+	void latch(PageLatch mode) {
+		if (bpm != NULL && this->mode == LATCH_NONE && mode != LATCH_NONE) {
+			bpm->latchPage(index, mode);
+			this->mode = mode;
+		}
+	}
+	/*
+	 * @函数名unlatch
+	 * 功能:释放锁但不解除固定，页面的地址仍然有效，但内容可能被其他线程修改
+	 */
+	void unlatch() {
+		if (bpm != NULL && mode != LATCH_NONE) {
+			bpm->unlatchPage(index);
+			mode = LATCH_NONE;
+		}
+	}
+	/*
+	 * @函数名release
+	 * 功能:提前释放锁并解除固定，之后不能再使用data返回的地址
+	 */
+	void release() {
+		if (bpm != NULL) {
+			if (mode != LATCH_NONE) {
+				bpm->unlatchPage(index);
+			}
+			bpm->unpin(index);
+			bpm = NULL;
+			buf = NULL;
+			index = -1;
+		}
+	}
+};
+#endif
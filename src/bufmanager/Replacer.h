@@ -0,0 +1,50 @@
+#ifndef BUF_REPLACER
+#define BUF_REPLACER
+/*
+ * Replacer
+ * 替换算法的接口，缓存管理器通过它决定替换哪个缓存页面
+ */
+class Replacer {
+public:
+	/*
+	 * @函数名free
+	 * @参数index:缓存页面数组中页面的下标
+	 * 功能:将缓存页面数组中第index个页面的缓存空间回收
+	 *           下一次通过find函数寻找替换页面时，直接返回index
+	 */
+	virtual void free(int index) = 0;
+	/*
+	 * @函数名access
+	 * @参数index:缓存页面数组中页面的下标
+	 * 功能:将缓存页面数组中第index个页面标记为访问
+	 */
+	virtual void access(int index) = 0;
+	/*
+	 * @函数名accessOnce
+	 * @参数index:缓存页面数组中页面的下标
+	 * 功能:标记一次不会再重复的访问，例如顺序扫描读过的页面，这样的页面应当尽早被替换
+	 */
+	virtual void accessOnce(int index) = 0;
+	/*
+	 * @函数名find
+	 * 功能:根据替换算法返回缓存页面数组中要被替换页面的下标
+	 */
+	virtual int find() = 0;
+	/*
+	 * @函数名coldest
+	 * @参数out:用于存储页面下标
+	 * @参数max:最多返回的页面个数
+	 * 功能:按将要被替换的先后顺序列出页面，不改变替换算法的状态，供后台写回线程使用
+	 * 返回:列出的页面个数
+	 */
+	virtual int coldest(int* out, int max) = 0;
+	/*
+	 * @函数名resize
+	 * @参数c:新的缓存页面容量上限
+	 * 功能:新增的页面最先被find返回，缩小时，下标不小于c的页面被丢弃
+	 */
+	virtual void resize(int c) = 0;
+	virtual const char* name() const = 0;
+	virtual ~Replacer() {}
+};
+#endif
@@ -0,0 +1,140 @@
+#ifndef BUF_TWO_Q
+#define BUF_TWO_Q
+#include "../utils/MyLinkList.h"
+#include "../utils/pagedef.h"
+#include "Replacer.h"
+/*
+ * TwoQReplace
+ * 简化的2Q替换算法
+ * 新读入的页面先进入先进先出的试用队列，在试用队列中再次被访问才进入LRU的保护队列
+ * 试用队列超过容量的1/4时优先从试用队列中替换，一次全表扫描只会冲掉试用队列，
+ * 不会把索引内部节点、系统表等经常访问的页面挤出缓存
+ */
+class TwoQReplace : public Replacer {
+private:
+	/*
+	 * 三个链表:空闲页面、试用队列、保护队列
+	 */
+	static const int FREE = 0;
+	static const int PROBATION = 1;
+	static const int PROTECTED = 2;
+	MyLinkList* list;
+	int* where;
+	int size[3];
+	int CAP_;
+	int probationMax;
+	void move(int index, int to) {
+		-- size[where[index]];
+		list->insert(to, index);
+		where[index] = to;
+		++ size[to];
+	}
+	void build(int c) {
+		CAP_ = c;
+		probationMax = (c / 4 > 0) ? c / 4 : 1;
+		list = new MyLinkList(c, 3);
+		where = new int[c];
+		size[FREE] = size[PROBATION] = size[PROTECTED] = 0;
+	}
+public:
+	/*
+	 * @函数名free
+	 * 功能:回收页面，下一次find时首先返回
+	 */
+	void free(int index) {
+		-- size[where[index]];
+		list->insertFirst(FREE, index);
+		where[index] = FREE;
+		++ size[FREE];
+	}
+	/*
+	 * @函数名access
+	 * 功能:试用队列中的页面被再次访问时进入保护队列，保护队列中的页面移到队尾
+	 */
+	void access(int index) {
+		move(index, PROTECTED);
+	}
+	/*
+	 * @函数名accessOnce
+	 * 功能:只访问一次的页面留在试用队列中，保持原来的位置
+	 */
+	void accessOnce(int index) {
+		if (where[index] == FREE) {
+			move(index, PROBATION);
+		}
+	}
+	/*
+	 * @函数名find
+	 * 功能:依次从空闲页面、超出容量的试用队列、保护队列中选出要替换的页面
+	 *           选中的页面放到试用队列的队尾
+	 */
+	int find() {
+		int from;
+		if (size[FREE] > 0) {
+			from = FREE;
+		} else if (size[PROBATION] > probationMax || size[PROTECTED] == 0) {
+			from = PROBATION;
+		} else {
+			from = PROTECTED;
+		}
+		int index = list->getFirst(from);
+		move(index, PROBATION);
+		return index;
+	}
+	int coldest(int* out, int max) {
+		int order[2] = {PROBATION, PROTECTED};
+		if (size[PROBATION] <= probationMax && size[PROTECTED] > 0) {
+			order[0] = PROTECTED;
+			order[1] = PROBATION;
+		}
+		int n = 0;
+		for (int k = 0; k < 2; ++ k) {
+			for (int p = list->getFirst(order[k]); !list->isHead(p) && n < max; p = list->next(p)) {
+				out[n++] = p;
+			}
+		}
+		return n;
+	}
+	void resize(int c) {
+		MyLinkList* old = list;
+		int* oldWhere = where;
+		int oldCap = CAP_;
+		build(c);
+		for (int i = oldCap; i < c; ++ i) {
+			list->insert(FREE, i);
+			where[i] = FREE;
+			++ size[FREE];
+		}
+		for (int l = 0; l < 3; ++ l) {
+			for (int p = old->getFirst(l); !old->isHead(p); p = old->next(p)) {
+				if (p < c) {
+					list->insert(l, p);
+					where[p] = l;
+					++ size[l];
+				}
+			}
+		}
+		delete old;
+		delete[] oldWhere;
+	}
+	const char* name() const {
+		return "2q";
+	}
+	/*
+	 * 构造函数
+	 * @参数c:表示缓存页面的容量上限
+	 */
+	TwoQReplace(int c) {
+		build(c);
+		for (int i = 0; i < CAP_; ++ i) {
+			list->insert(FREE, i);
+			where[i] = FREE;
+		}
+		size[FREE] = c;
+	}
+	~TwoQReplace() {
+		delete list;
+		delete[] where;
+	}
+};
+#endif
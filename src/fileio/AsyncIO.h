@@ -0,0 +1,512 @@
+#ifndef ASYNC_IO
+#define ASYNC_IO
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include "../utils/pagedef.h"
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define HAVE_IO_URING 1
+#endif
+#endif
+#endif
+/*
+ * 异步读写请求
+ */
+struct IORequest {
+	int fd;
+	/*
+	 * 文件管理器中的文件id，请求完成后文件管理器才能关闭fd
+	 */
+	int fileID;
+	bool isWrite;
+	char* buf;
+	/*
+	 * iov不为NULL时请求读写iov中的iovcnt段内存，buf不使用
+	 * iov由调用者保存，在请求被reap取回之前不能修改
+	 */
+	struct iovec* iov;
+	int iovcnt;
+	/*
+	 * 请求的总字节数
+	 */
+	size_t len;
+	off_t offset;
+	/*
+	 * 调用者用来识别请求的标签，完成时原样返回
+	 */
+	int tag;
+	/*
+	 * 完成时的结果，成功为0，失败为-errno
+	 */
+	int result;
+};
+/*
+ * AsyncIO
+ * 异步读写引擎的接口，submit提交请求后立即返回，reap取回已完成的请求
+ * 每个请求要么全部读写完成，要么返回错误；读到文件末尾时剩余部分填0
+ */
+class AsyncIO {
+protected:
+	/*
+	 * 同步完成请求中从第skip个字节开始的部分
+	 */
+	static int _rwFull(const IORequest& r, size_t skip = 0) {
+		if (r.iov != NULL) {
+			return _rwvFull(r, skip);
+		}
+		char* b = r.buf + skip;
+		size_t len = r.len - skip;
+		off_t offset = r.offset + skip;
+		while (len > 0) {
+			ssize_t n = r.isWrite ? pwrite(r.fd, b, len, offset) : pread(r.fd, b, len, offset);
+			if (n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return -errno;
+			}
+			if (n == 0) {
+				if (r.isWrite) {
+					return -EIO;
+				}
+				memset(b, 0, len);
+				return 0;
+			}
+			b += n;
+			len -= n;
+			offset += n;
+		}
+		return 0;
+	}
+	static int _rwvFull(const IORequest& r, size_t skip) {
+		std::vector<struct iovec> v(r.iov, r.iov + r.iovcnt);
+		struct iovec* iov = &v[0];
+		int cnt = r.iovcnt;
+		off_t offset = r.offset + skip;
+		while (true) {
+			while (cnt > 0 && skip >= iov->iov_len) {
+				skip -= iov->iov_len;
+				++ iov;
+				-- cnt;
+			}
+			if (cnt == 0) {
+				return 0;
+			}
+			iov->iov_base = (char*) iov->iov_base + skip;
+			iov->iov_len -= skip;
+			int k = (cnt > IOV_MAX) ? IOV_MAX : cnt;
+			ssize_t n = r.isWrite ? pwritev(r.fd, iov, k, offset) : preadv(r.fd, iov, k, offset);
+			if (n < 0) {
+				if (errno == EINTR) {
+					skip = 0;
+					continue;
+				}
+				return -errno;
+			}
+			if (n == 0) {
+				if (r.isWrite) {
+					return -EIO;
+				}
+				for (int i = 0; i < cnt; ++ i) {
+					memset(iov[i].iov_base, 0, iov[i].iov_len);
+				}
+				return 0;
+			}
+			skip = n;
+			offset += n;
+		}
+	}
+public:
+	virtual ~AsyncIO() {}
+	/*
+	 * @函数名submit
+	 * 功能:提交一个请求，队列已满时返回false，调用者应先reap再重试
+	 *           请求可能先在用户态排队，调用push或reap后才保证开始执行
+	 */
+	virtual bool submit(const IORequest& req) = 0;
+	/*
+	 * @函数名push
+	 * 功能:把排队的请求一次交给内核，连续提交多个请求后调用一次即可
+	 */
+	virtual void push() {}
+	/*
+	 * @函数名reap
+	 * @参数done:用于存储已完成的请求
+	 * @参数max:最多取回的请求个数
+	 * @参数wait:没有已完成的请求时是否阻塞等待
+	 * 返回:取回的请求个数
+	 */
+	virtual int reap(IORequest* done, int max, bool wait) = 0;
+	/*
+	 * 已提交但还没有被reap取回的请求个数
+	 */
+	virtual int inFlight() = 0;
+	virtual const char* name() = 0;
+	static AsyncIO* create(int depth);
+};
+/*
+ * ThreadPoolIO
+ * 用若干个工作线程执行pread/pwrite，在没有io_uring的内核上使用
+ */
+class ThreadPoolIO : public AsyncIO {
+private:
+	std::mutex latch;
+	std::condition_variable hasWork, hasDone;
+	std::deque<IORequest> pending, finished;
+	std::vector<std::thread> workers;
+	int depth;
+	int outstanding;
+	bool stopping;
+	void work() {
+		std::unique_lock<std::mutex> lock(latch);
+		while (true) {
+			while (!stopping && pending.empty()) {
+				hasWork.wait(lock);
+			}
+			if (pending.empty()) {
+				return;
+			}
+			IORequest r = pending.front();
+			pending.pop_front();
+			lock.unlock();
+			r.result = _rwFull(r);
+			lock.lock();
+			finished.push_back(r);
+			hasDone.notify_all();
+		}
+	}
+public:
+	ThreadPoolIO(int d, int threads) {
+		depth = d;
+		outstanding = 0;
+		stopping = false;
+		for (int i = 0; i < threads; ++ i) {
+			workers.push_back(std::thread(&ThreadPoolIO::work, this));
+		}
+	}
+	~ThreadPoolIO() {
+		{
+			std::lock_guard<std::mutex> lock(latch);
+			stopping = true;
+		}
+		hasWork.notify_all();
+		for (size_t i = 0; i < workers.size(); ++ i) {
+			workers[i].join();
+		}
+	}
+	bool submit(const IORequest& req) {
+		std::lock_guard<std::mutex> lock(latch);
+		if (outstanding >= depth) {
+			return false;
+		}
+		outstanding ++;
+		pending.push_back(req);
+		hasWork.notify_one();
+		return true;
+	}
+	int reap(IORequest* done, int max, bool wait) {
+		std::unique_lock<std::mutex> lock(latch);
+		while (wait && finished.empty() && outstanding > 0) {
+			hasDone.wait(lock);
+		}
+		int n = 0;
+		while (n < max && !finished.empty()) {
+			done[n++] = finished.front();
+			finished.pop_front();
+		}
+		outstanding -= n;
+		return n;
+	}
+	int inFlight() {
+		std::lock_guard<std::mutex> lock(latch);
+		return outstanding;
+	}
+	const char* name() {
+		return "threadpool";
+	}
+};
+#ifdef HAVE_IO_URING
+/*
+ * UringIO
+ * 直接通过系统调用使用io_uring，不依赖liburing
+ * 只能由一个线程使用
+ */
+class UringIO : public AsyncIO {
+private:
+	int ringFd;
+	unsigned entries;
+	unsigned* sqHead, *sqTail, *sqMask, *sqArray;
+	unsigned* cqHead, *cqTail, *cqMask;
+	struct io_uring_sqe* sqes;
+	struct io_uring_cqe* cqes;
+	void* sqRing, *cqRing;
+	size_t sqRingSize, cqRingSize;
+	/*
+	 * 每个提交队列位置对应的请求和iovec，user_data中记录位置下标
+	 */
+	std::vector<IORequest> slots;
+	std::vector<struct iovec> iovs;
+	std::vector<int> freeSlots;
+	int outstanding;
+	/*
+	 * 已经放入提交队列但内核还没有接收的请求个数
+	 * io_uring_enter因资源不足失败时，请求留在队列中，下一次调用时再提交
+	 */
+	unsigned unsubmitted;
+	/*
+	 * io_uring_enter出现EAGAIN、EBUSY以外的错误后不再使用内核队列
+	 * 之后的请求在submit中同步完成，放在syncDone中等待reap取回
+	 */
+	bool broken;
+	std::vector<IORequest> syncDone;
+	/*
+	 * 取走完成队列头部的一项，返回对应的请求并归还它的位置
+	 */
+	IORequest pop(unsigned head) {
+		struct io_uring_cqe* cqe = &cqes[head & *cqMask];
+		int slot = (int) cqe->user_data;
+		int res = cqe->res;
+		__atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+		IORequest& r = slots[slot];
+		if (res < 0) {
+			r.result = res;
+		} else if ((size_t) res < r.len) {
+			// 读写不满时同步完成剩余部分
+			r.result = _rwFull(r, res);
+		} else {
+			r.result = 0;
+		}
+		freeSlots.push_back(slot);
+		return r;
+	}
+	/*
+	 * 内核队列不可用时完成所有还没有取回的请求
+	 * 提交队列中内核还没有取走的请求从未开始，直接同步完成
+	 * 内核已经接收的请求仍会写入调用者的缓冲区，不能重做，等它们出现在完成队列中再交给调用者，
+	 * 完成队列由内核直接更新，不需要io_uring_enter
+	 */
+	int fail(IORequest* done, int n, int max) {
+		broken = true;
+		unsubmitted = 0;
+		unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+		for (unsigned pos = head; pos != *sqTail; ++ pos) {
+			int slot = (int) sqes[sqArray[pos & *sqMask]].user_data;
+			slots[slot].result = _rwFull(slots[slot]);
+			syncDone.push_back(slots[slot]);
+			freeSlots.push_back(slot);
+		}
+		// 撤回这些提交队列项，内核不会再取到它们
+		__atomic_store_n(sqTail, head, __ATOMIC_RELEASE);
+		while (freeSlots.size() < entries) {
+			head = *cqHead;
+			if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+				// 完成可能要在返回用户态时由本线程处理，睡眠一下让它发生
+				usleep(100);
+				continue;
+			}
+			syncDone.push_back(pop(head));
+		}
+		while (n < max && !syncDone.empty()) {
+			done[n++] = syncDone.back();
+			syncDone.pop_back();
+		}
+		return n;
+	}
+	int flush(unsigned minComplete) {
+		unsigned flags = (minComplete > 0) ? IORING_ENTER_GETEVENTS : 0;
+		while (true) {
+			int r = syscall(__NR_io_uring_enter, ringFd, unsubmitted, minComplete, flags, NULL, 0);
+			if (r >= 0) {
+				unsubmitted -= r;
+				return r;
+			}
+			if (errno != EINTR) {
+				return r;
+			}
+		}
+	}
+public:
+	UringIO() {
+		ringFd = -1;
+		sqRing = cqRing = MAP_FAILED;
+		sqes = NULL;
+		outstanding = 0;
+		unsubmitted = 0;
+		broken = false;
+	}
+	bool init(int depth) {
+		struct io_uring_params p;
+		memset(&p, 0, sizeof(p));
+		ringFd = syscall(__NR_io_uring_setup, depth, &p);
+		if (ringFd < 0) {
+			return false;
+		}
+		entries = p.sq_entries;
+		sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+		bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#else
+		bool single = false;
+#endif
+		if (single && cqRingSize > sqRingSize) {
+			sqRingSize = cqRingSize;
+		}
+		sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+		if (sqRing == MAP_FAILED) {
+			return false;
+		}
+		if (single) {
+			cqRing = sqRing;
+		} else {
+			cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+			if (cqRing == MAP_FAILED) {
+				return false;
+			}
+		}
+		void* s = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+		if (s == MAP_FAILED) {
+			return false;
+		}
+		sqes = (struct io_uring_sqe*) s;
+		char* sq = (char*) sqRing;
+		char* cq = (char*) cqRing;
+		sqHead = (unsigned*) (sq + p.sq_off.head);
+		sqTail = (unsigned*) (sq + p.sq_off.tail);
+		sqMask = (unsigned*) (sq + p.sq_off.ring_mask);
+		sqArray = (unsigned*) (sq + p.sq_off.array);
+		cqHead = (unsigned*) (cq + p.cq_off.head);
+		cqTail = (unsigned*) (cq + p.cq_off.tail);
+		cqMask = (unsigned*) (cq + p.cq_off.ring_mask);
+		cqes = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+		slots.resize(entries);
+		iovs.resize(entries);
+		for (int i = entries - 1; i >= 0; -- i) {
+			freeSlots.push_back(i);
+		}
+		return true;
+	}
+	~UringIO() {
+		if (sqes != NULL) {
+			munmap(sqes, entries * sizeof(struct io_uring_sqe));
+		}
+		if (cqRing != MAP_FAILED && cqRing != sqRing) {
+			munmap(cqRing, cqRingSize);
+		}
+		if (sqRing != MAP_FAILED) {
+			munmap(sqRing, sqRingSize);
+		}
+		if (ringFd >= 0) {
+			::close(ringFd);
+		}
+	}
+	bool submit(const IORequest& req) {
+		if (broken) {
+			IORequest r = req;
+			r.result = _rwFull(r);
+			syncDone.push_back(r);
+			outstanding ++;
+			return true;
+		}
+		if (freeSlots.empty()) {
+			return false;
+		}
+		unsigned tail = *sqTail;
+		if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= entries) {
+			return false;
+		}
+		int slot = freeSlots.back();
+		freeSlots.pop_back();
+		slots[slot] = req;
+		iovs[slot].iov_base = req.buf;
+		iovs[slot].iov_len = req.len;
+		bool vec = (req.iov != NULL);
+		unsigned pos = tail & *sqMask;
+		struct io_uring_sqe* sqe = &sqes[pos];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = req.isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe->fd = req.fd;
+		sqe->off = req.offset;
+		sqe->addr = (unsigned long) (vec ? req.iov : &iovs[slot]);
+		sqe->len = vec ? req.iovcnt : 1;
+		sqe->user_data = slot;
+		sqArray[pos] = pos;
+		__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+		outstanding ++;
+		unsubmitted ++;
+		return true;
+	}
+	void push() {
+		if (!broken && unsubmitted > 0) {
+			flush(0);
+		}
+	}
+	int reap(IORequest* done, int max, bool wait) {
+		int n = 0;
+		while (n < max && !syncDone.empty()) {
+			done[n++] = syncDone.back();
+			syncDone.pop_back();
+		}
+		while (n < max && !broken) {
+			unsigned head = *cqHead;
+			if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+				if (wait && n == 0 && outstanding > 0) {
+					if (flush(1) < 0 && errno != EAGAIN && errno != EBUSY) {
+						n = fail(done, n, max);
+						break;
+					}
+					continue;
+				}
+				if (unsubmitted > 0) {
+					flush(0);
+				}
+				break;
+			}
+			done[n++] = pop(head);
+		}
+		outstanding -= n;
+		return n;
+	}
+	int inFlight() {
+		return outstanding;
+	}
+	const char* name() {
+		return "io_uring";
+	}
+};
+#endif
+/*
+ * @函数名create
+ * @参数depth:最多同时在途的请求个数
+ * 功能:内核支持时使用io_uring，否则使用线程池
+ *           环境变量MINISQL_AIO=threadpool可以强制使用线程池
+ */
+inline AsyncIO* AsyncIO::create(int depth) {
+	const char* mode = getenv("MINISQL_AIO");
+#ifdef HAVE_IO_URING
+	if (mode == NULL || strcmp(mode, "threadpool") != 0) {
+		UringIO* u = new UringIO();
+		if (u->init(depth)) {
+			return u;
+		}
+		delete u;
+	}
+#endif
+	(void) mode;
+	return new ThreadPoolIO(depth, AIO_THREAD_NUM);
+}
+#endif
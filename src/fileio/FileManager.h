@@ -7,14 +7,63 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include "AsyncIO.h"
+#include "../utils/MyLinkList.h"
+#include <algorithm>
 //#include "../MyLinkList.h"
 using namespace std;
 class FileManager {
 private:
 	//FileTable* ftable;
+	/*
+	 * 文件id是逻辑上的编号，打开期间不变，缓存管理器用它区分页面
+	 * 同时打开的文件描述符不超过MAX_OPEN_FD个，不够时关闭最久没有使用的描述符，再次使用时按文件名重新打开
+	 * fd[fileID]为-1表示文件的描述符已经被关闭
+	 */
 	int fd[MAX_FILE_NUM];
+	std::string fname[MAX_FILE_NUM];
+	/*
+	 * 正在使用描述符的读写个数，大于0时描述符不会被关闭
+	 */
+	int users[MAX_FILE_NUM];
+	/*
+	 * 文件是否以O_DIRECT打开，读写绕过内核的页缓存
+	 */
+	bool directFd[MAX_FILE_NUM];
+	bool direct;
+	/*
+	 * 打开着描述符的文件，按最近使用的顺序排列
+	 */
+	MyLinkList* fdList;
+	int fdNum;
+	/*
+	 * 保护上面的描述符状态，缓存管理器的多个分片会同时读写
+	 */
+	std::mutex fdLatch;
+	/*
+	 * 写入之后还没有落盘的文件，由syncBarrier统一落盘
+	 */
+	bool unsynced[MAX_FILE_NUM];
+	std::vector<int> unsyncedList;
+	/*
+	 * 组提交的状态，编号不大于syncDone的落盘请求已经完成
+	 * 编号在(syncFailFrom, syncFailTo]中的请求属于最近一次失败的组
+	 */
+	std::mutex syncMutex;
+	std::condition_variable syncCv;
+	long long syncTicket;
+	long long syncDone;
+	long long syncFailFrom;
+	long long syncFailTo;
+	bool syncing;
 	MyBitMap* fm;
 	MyBitMap* tm;
+	AsyncIO* aio;
 	int _createFile(const char* name) {
 		FILE* f = fopen(name, "a+");
 		if (f == NULL) {
@@ -25,6 +74,20 @@ private:
 		return 0;
 	}
 	int _openFile(const char* name, int fileID) {
+		directFd[fileID] = false;
+#ifdef O_DIRECT
+		if (direct) {
+			int f = open(name, O_RDWR | O_DIRECT);
+			if (f != -1 && _probeDirect(f)) {
+				fd[fileID] = f;
+				directFd[fileID] = true;
+				return 0;
+			}
+			if (f != -1) {
+				close(f);
+			}
+		}
+#endif
 		int f = open(name, O_RDWR);
 		if (f == -1) {
 			return -1;
@@ -32,13 +95,224 @@ private:
 		fd[fileID] = f;
 		return 0;
 	}
+	/*
+	 * 取得文件的描述符，描述符已经被关闭时重新打开，无论是否成功，使用完之后都要调用_release
+	 * 重新打开失败时返回-1，读写会以EBADF失败
+	 * 要求持有fdLatch
+	 */
+	int _acquire(int fileID) {
+		++ users[fileID];
+		if (fd[fileID] == -1) {
+			if (fdNum >= MAX_OPEN_FD) {
+				_evictFd();
+			}
+			int flags = O_RDWR;
+#ifdef O_DIRECT
+			if (directFd[fileID]) {
+				flags |= O_DIRECT;
+			}
+#endif
+			int f = open(fname[fileID].c_str(), flags);
+			if (f == -1) {
+				return -1;
+			}
+			fd[fileID] = f;
+			++ fdNum;
+		}
+		fdList->insert(0, fileID);
+		return fd[fileID];
+	}
+	int _acquireLocked(int fileID) {
+		std::lock_guard<std::mutex> lock(fdLatch);
+		return _acquire(fileID);
+	}
+	void _release(int fileID) {
+		std::lock_guard<std::mutex> lock(fdLatch);
+		-- users[fileID];
+	}
+	/*
+	 * 记录文件被写过，要求持有syncMutex
+	 */
+	void _markUnsynced(int fileID) {
+		if (!unsynced[fileID]) {
+			unsynced[fileID] = true;
+			unsyncedList.push_back(fileID);
+		}
+	}
+	void _written(int fileID) {
+		std::lock_guard<std::mutex> lock(syncMutex);
+		_markUnsynced(fileID);
+	}
+	/*
+	 * 关闭最久没有使用、并且没有读写正在使用的描述符，都在使用时暂时超过MAX_OPEN_FD个
+	 */
+	void _evictFd() {
+		for (int p = fdList->getFirst(0); !fdList->isHead(p); p = fdList->next(p)) {
+			if (users[p] == 0) {
+				close(fd[p]);
+				fd[p] = -1;
+				-- fdNum;
+				fdList->del(p);
+				return;
+			}
+		}
+	}
+	/*
+	 * 有的文件系统允许以O_DIRECT打开文件，但读写时返回EINVAL
+	 * 打开后先对齐地读一次，失败时退回到普通的读写
+	 */
+	static bool _probeDirect(int f) {
+		void* b;
+		if (posix_memalign(&b, FRAME_ALIGN, PAGE_SIZE) != 0) {
+			return false;
+		}
+		ssize_t r = pread(f, b, PAGE_SIZE, 0);
+		free(b);
+		return r >= 0;
+	}
+	/*
+	 * 从offset处开始读满len个字节，处理被信号打断和读不满的情况
+	 * 读到文件末尾时，剩余部分填0
+	 */
+	static int _preadFull(int f, char* b, size_t len, off_t offset) {
+		while (len > 0) {
+			ssize_t r = pread(f, b, len, offset);
+			if (r < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return -1;
+			}
+			if (r == 0) {
+				memset(b, 0, len);
+				return 0;
+			}
+			b += r;
+			len -= r;
+			offset += r;
+		}
+		return 0;
+	}
+	static int _pwriteFull(int f, const char* b, size_t len, off_t offset) {
+		while (len > 0) {
+			ssize_t r = pwrite(f, b, len, offset);
+			if (r < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return -1;
+			}
+			b += r;
+			len -= r;
+			offset += r;
+		}
+		return 0;
+	}
+	/*
+	 * 向量读写的公共部分，iov在调用过程中会被修改
+	 * 一次系统调用没有读写完时，跳过已完成的部分继续
+	 */
+	static int _pvFull(int f, struct iovec* iov, int cnt, off_t offset, bool isWrite) {
+		while (cnt > 0) {
+			int n = (cnt > IOV_MAX) ? IOV_MAX : cnt;
+			ssize_t r = isWrite ? pwritev(f, iov, n, offset) : preadv(f, iov, n, offset);
+			if (r < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return -1;
+			}
+			if (r == 0) {
+				if (isWrite) {
+					return -1;
+				}
+				for (int i = 0; i < cnt; ++ i) {
+					memset(iov[i].iov_base, 0, iov[i].iov_len);
+				}
+				return 0;
+			}
+			offset += r;
+			while (cnt > 0 && (size_t) r >= iov->iov_len) {
+				r -= iov->iov_len;
+				++ iov;
+				-- cnt;
+			}
+			if (cnt > 0) {
+				iov->iov_base = (char*) iov->iov_base + r;
+				iov->iov_len -= r;
+			}
+		}
+		return 0;
+	}
+	bool _submitPage(int fileID, int pageID, BufType buf, int tag, bool isWrite, struct iovec* iov = NULL, int n = 1) {
+		if (aio == NULL) {
+			aio = AsyncIO::create(IO_QUEUE_DEPTH);
+		}
+		IORequest r;
+		r.fd = _acquireLocked(fileID);
+		r.fileID = fileID;
+		r.isWrite = isWrite;
+		r.buf = (char*) buf;
+		r.iov = iov;
+		r.iovcnt = (iov == NULL) ? 0 : n;
+		r.len = (size_t) n * PAGE_SIZE;
+		r.offset = ((off_t) pageID << PAGE_SIZE_IDX);
+		r.tag = tag;
+		r.result = 0;
+		if (!aio->submit(r)) {
+			_release(fileID);
+			return false;
+		}
+		return true;
+	}
+	int _pagesIO(int fileID, int pageID, BufType* bufs, int n, bool isWrite) {
+		struct iovec iov[IO_RUN_PAGES];
+		off_t offset = pageID;
+		offset = (offset << PAGE_SIZE_IDX);
+		int f = _acquireLocked(fileID);
+		int ret = (f == -1) ? -1 : 0;
+		while (n > 0 && ret == 0) {
+			int k = (n > IO_RUN_PAGES) ? IO_RUN_PAGES : n;
+			for (int i = 0; i < k; ++ i) {
+				iov[i].iov_base = (void*) bufs[i];
+				iov[i].iov_len = PAGE_SIZE;
+			}
+			if (_pvFull(f, iov, k, offset, isWrite) != 0) {
+				ret = -1;
+			}
+			bufs += k;
+			n -= k;
+			offset += ((off_t) k << PAGE_SIZE_IDX);
+		}
+		_release(fileID);
+		if (isWrite) {
+			_written(fileID);
+		}
+		return ret;
+	}
 public:
 	/*
 	 * FilManager构造函数
 	 */
 	FileManager() {
+		const char* env = getenv("MINISQL_DIRECT_IO");
+		direct = (env != NULL && strcmp(env, "on") == 0);
+		for (int i = 0; i < MAX_FILE_NUM; ++ i) {
+			fd[i] = -1;
+			users[i] = 0;
+			directFd[i] = false;
+		}
+		fdList = new MyLinkList(MAX_FILE_NUM, 1);
+		fdNum = 0;
+		for (int i = 0; i < MAX_FILE_NUM; ++ i) {
+			unsynced[i] = false;
+		}
+		syncTicket = syncDone = 0;
+		syncFailFrom = syncFailTo = 0;
+		syncing = false;
 		fm = new MyBitMap(MAX_FILE_NUM, 1);
 		tm = new MyBitMap(MAX_TYPE_NUM, 1);
+		aio = NULL;
 	}
 	/*
 	 * @函数名writePage
@@ -50,16 +324,14 @@ public:
 	 * 返回:成功操作返回0
 	 */
 	int writePage(int fileID, int pageID, BufType buf, int off) {
-		int f = fd[fileID];
 		off_t offset = pageID;
 		offset = (offset << PAGE_SIZE_IDX);
-		off_t error = lseek(f, offset, SEEK_SET);
-		if (error != offset) {
-			return -1;
-		}
 		BufType b = buf + off;
-		error = write(f, (void*) b, PAGE_SIZE);
-		return 0;
+		int f = _acquireLocked(fileID);
+		int ret = (f == -1) ? -1 : _pwriteFull(f, (const char*) b, PAGE_SIZE, offset);
+		_release(fileID);
+		_written(fileID);
+		return ret;
 	}
 	/*
 	 * @函数名readPage
@@ -71,29 +343,219 @@ public:
 	 * 返回:成功操作返回0
 	 */
 	int readPage(int fileID, int pageID, BufType buf, int off) {
-		//int f = fd[fID[type]];
-		int f = fd[fileID];
 		off_t offset = pageID;
 		offset = (offset << PAGE_SIZE_IDX);
-		off_t error = lseek(f, offset, SEEK_SET);
-		if (error != offset) {
-			return -1;
-		}
 		BufType b = buf + off;
-		error = read(f, (void*) b, PAGE_SIZE);
-		return 0;
+		int f = _acquireLocked(fileID);
+		int ret = (f == -1) ? -1 : _preadFull(f, (char*) b, PAGE_SIZE, offset);
+		_release(fileID);
+		return ret;
+	}
+	/*
+	 * @函数名writePages
+	 * @参数fileID:文件id，用于区别已经打开的文件
+	 * @参数pageID:第一个文件页号
+	 * @参数bufs:n个缓存页面的首地址，bufs[i]写入文件页pageID+i
+	 * @参数n:连续写出的页面个数
+	 * 功能:将bufs中的n个页面写入从pageID开始的相邻文件页，每IO_RUN_PAGES个页面只需一次系统调用
+	 * 返回:成功操作返回0
+	 */
+	int writePages(int fileID, int pageID, BufType* bufs, int n) {
+		return _pagesIO(fileID, pageID, bufs, n, true);
+	}
+	/*
+	 * @函数名submitReadPage
+	 * @参数fileID:文件id
+	 * @参数pageID:文件页号
+	 * @参数buf:缓存页面的首地址，在请求完成前不能被使用
+	 * @参数tag:请求完成时原样返回给调用者
+	 * 功能:提交一个异步读页面的请求，立即返回
+	 * 返回:在途请求已满时返回false，调用者需要先用reapPages取回已完成的请求
+	 */
+	bool submitReadPage(int fileID, int pageID, BufType buf, int tag) {
+		return _submitPage(fileID, pageID, buf, tag, false);
+	}
+	/*
+	 * @函数名submitReadPages
+	 * @参数fileID:文件id
+	 * @参数pageID:第一个文件页号
+	 * @参数iov:n个缓存页面，iov[i]对应文件页pageID+i，在请求完成前不能被修改
+	 * @参数n:连续读入的页面个数
+	 * @参数tag:请求完成时原样返回给调用者
+	 * 功能:提交一个读入n个相邻文件页的异步请求，整个请求只需一次向量读
+	 * 返回:在途请求已满时返回false
+	 */
+	bool submitReadPages(int fileID, int pageID, struct iovec* iov, int n, int tag) {
+		return _submitPage(fileID, pageID, NULL, tag, false, iov, n);
+	}
+	/*
+	 * @函数名submitWritePage
+	 * 功能:提交一个异步写页面的请求，参数同submitReadPage
+	 */
+	bool submitWritePage(int fileID, int pageID, BufType buf, int tag) {
+		return _submitPage(fileID, pageID, buf, tag, true);
+	}
+	/*
+	 * @函数名pushPages
+	 * 功能:让已提交的异步请求开始执行，连续提交多个请求后调用一次
+	 */
+	void pushPages() {
+		if (aio != NULL) {
+			aio->push();
+		}
+	}
+	/*
+	 * @函数名reapPages
+	 * @参数done:用于存储已完成的请求，done[i].tag为提交时的tag，done[i].result为0表示成功
+	 * @参数max:最多取回的请求个数
+	 * @参数wait:没有已完成的请求时是否阻塞等待
+	 * 返回:取回的请求个数
+	 */
+	int reapPages(IORequest* done, int max, bool wait) {
+		if (aio == NULL) {
+			return 0;
+		}
+		int n = aio->reap(done, max, wait);
+		for (int i = 0; i < n; ++ i) {
+			_release(done[i].fileID);
+			if (done[i].isWrite) {
+				_written(done[i].fileID);
+			}
+		}
+		return n;
+	}
+	int pagesInFlight() {
+		return (aio == NULL) ? 0 : aio->inFlight();
+	}
+	/*
+	 * @函数名isDirect
+	 * @参数fileID:文件id
+	 * 返回:文件是否以O_DIRECT打开
+	 */
+	bool isDirect(int fileID) {
+		return directFd[fileID];
+	}
+	/*
+	 * @函数名mapFile
+	 * @参数fileID:文件id
+	 * @参数pageNum:映射的页面个数，从文件页0开始
+	 * 功能:将文件的前pageNum个页面只读地映射到内存中，并提示内核将按顺序访问
+	 *           映射期间通过缓存写入的内容在映射中同样可见，但调用者需要先将缓存中的脏页写回
+	 * 返回:映射的首地址，文件长度不足或映射失败时返回NULL
+	 *           以O_DIRECT打开的文件也返回NULL，映射会把页面重新读进内核的页缓存
+	 */
+	BufType mapFile(int fileID, int pageNum) {
+		struct stat st;
+		size_t len = ((size_t) pageNum) << PAGE_SIZE_IDX;
+		if (pageNum <= 0 || directFd[fileID]) {
+			return NULL;
+		}
+		int f = _acquireLocked(fileID);
+		void* p = MAP_FAILED;
+		if (f != -1 && fstat(f, &st) == 0 && (size_t) st.st_size >= len) {
+			p = mmap(NULL, len, PROT_READ, MAP_SHARED, f, 0);
+		}
+		_release(fileID);
+		if (p == MAP_FAILED) {
+			return NULL;
+		}
+		madvise(p, len, MADV_SEQUENTIAL);
+		madvise(p, len, MADV_WILLNEED);
+		return (BufType) p;
+	}
+	/*
+	 * @函数名unmapFile
+	 * @参数base:mapFile返回的首地址
+	 * @参数pageNum:映射时的页面个数
+	 */
+	void unmapFile(BufType base, int pageNum) {
+		if (base != NULL) {
+			munmap(base, ((size_t) pageNum) << PAGE_SIZE_IDX);
+		}
+	}
+	/*
+	 * @函数名syncFile
+	 * @参数fileID:文件id
+	 * 功能:等待已经写入文件的页面落盘
+	 * 返回:成功操作返回0
+	 */
+	int syncFile(int fileID) {
+		int f = _acquireLocked(fileID);
+		int ret = (f == -1) ? -1 : fdatasync(f);
+		_release(fileID);
+		return ret;
+	}
+	/*
+	 * @函数名syncBarrier
+	 * 功能:等待调用之前所有写入文件的页面落盘，每个写过的文件只调用一次fdatasync
+	 *           多个线程同时调用时，一个线程替等待的所有线程落盘，其余线程等它完成，
+	 *           落盘期间到达的调用由下一组共同完成
+	 * 返回:成功操作返回0，有文件落盘失败时返回-1，失败的文件留到下一次调用重试
+	 */
+	int syncBarrier() {
+		std::unique_lock<std::mutex> lock(syncMutex);
+		long long ticket = ++ syncTicket;
+		while (syncDone < ticket && syncing) {
+			syncCv.wait(lock);
+		}
+		if (syncDone >= ticket) {
+			return (ticket > syncFailFrom && ticket <= syncFailTo) ? -1 : 0;
+		}
+		syncing = true;
+		long long from = syncDone;
+		long long to = syncTicket;
+		std::vector<int> files;
+		files.swap(unsyncedList);
+		for (size_t i = 0; i < files.size(); ++ i) {
+			unsynced[files[i]] = false;
+		}
+		lock.unlock();
+		std::vector<int> failed;
+		for (size_t i = 0; i < files.size(); ++ i) {
+			if (syncFile(files[i]) != 0) {
+				failed.push_back(files[i]);
+			}
+		}
+		lock.lock();
+		for (size_t i = 0; i < failed.size(); ++ i) {
+			_markUnsynced(failed[i]);
+		}
+		if (!failed.empty()) {
+			syncFailFrom = from;
+			syncFailTo = to;
+		}
+		syncDone = to;
+		syncing = false;
+		syncCv.notify_all();
+		return failed.empty() ? 0 : -1;
 	}
 	/*
 	 * @函数名closeFile
 	 * @参数fileID:用于区别已经打开的文件
-	 * 功能:关闭文件
-	 * 返回:操作成功，返回0
+	 * 功能:关闭文件，写过但还没有落盘的文件先落盘
+	 * 返回:操作成功，返回0，落盘失败时返回-1，文件仍然被关闭
 	 */
 	int closeFile(int fileID) {
+		int ret = 0;
+		{
+			// 文件id关闭后不再被syncBarrier跟踪，先把写过的内容落盘
+			std::lock_guard<std::mutex> lock(syncMutex);
+			if (unsynced[fileID]) {
+				ret = syncFile(fileID);
+				unsynced[fileID] = false;
+				unsyncedList.erase(std::find(unsyncedList.begin(), unsyncedList.end(), fileID));
+			}
+		}
+		std::lock_guard<std::mutex> lock(fdLatch);
 		fm->setBit(fileID, 1);
-		int f = fd[fileID];
-		close(f);
-		return 0;
+		if (fd[fileID] != -1) {
+			close(fd[fileID]);
+			fd[fileID] = -1;
+			-- fdNum;
+		}
+		fdList->del(fileID);
+		fname[fileID].clear();
+		return (ret == 0) ? 0 : -1;
 	}
 	/*
 	 * @函数名createFile
@@ -109,13 +571,23 @@ public:
 	 * @函数名openFile
 	 * @参数name:文件名
 	 * @参数fileID:函数返回时，如果成功打开文件，那么为该文件分配一个id，记录在fileID中
-	 * 功能:打开文件
+	 * 功能:打开文件，环境变量MINISQL_DIRECT_IO为on时以O_DIRECT打开，文件系统不支持时退回到普通的读写
+	 *           以O_DIRECT读写的内存地址必须按FRAME_ALIGN对齐，缓存管理器的页面满足这个要求
 	 * 返回:如果成功打开，在fileID中存储为该文件分配的id，返回true，否则返回false
 	 */
 	bool openFile(const char* name, int& fileID) {
+		std::lock_guard<std::mutex> lock(fdLatch);
 		fileID = fm->findLeftOne();
 		fm->setBit(fileID, 0);
-		_openFile(name, fileID);
+		fname[fileID] = name;
+		users[fileID] = 0;
+		if (fdNum >= MAX_OPEN_FD) {
+			_evictFd();
+		}
+		if (_openFile(name, fileID) == 0) {
+			++ fdNum;
+			fdList->insert(0, fileID);
+		}
 		return true;
 	}
 	int newType() {
@@ -127,8 +599,11 @@ public:
 		tm->setBit(typeID, 1);
 	}
 	void shutdown() {
+		delete aio;
+		aio = NULL;
 		delete tm;
 		delete fm;
+		delete fdList;
 	}
 	~FileManager() {
 		this->shutdown();
@@ -1,29 +1,165 @@
 #pragma once
 
 #include <vector>
+#include <type_traits>
 #include <memory.h>
 #include <assert.h>
 
 #include "constants.h"
+#include "../bufmanager/PageGuard.h"
+#include "../utils/cpu.h"
 
+// Single-int keys are binary searched down to this many, which are then counted in one pass.
+#define SEARCH_WINDOW 32
+
+// RIDs are moved around the page with memmove.
+static_assert(std::is_trivially_copyable<RID>::value, "RID must be trivially copyable");
+
+// A node is read and modified in place in its pinned buffer frame. The page holds the NodeHeader,
+// then maxKeys() + 1 keys of num_attrs ints each (one more than a node keeps, for the overflow
+// before a split), then maxKeys() + 2 children of an internal node or maxKeys() + 1 RIDs of a leaf.
+// Nodes are pinned but not latched, so one index must not be modified by two threads at once.
 class TreeNode
 {
+private:
+    PageGuard guard;
+    int num_attrs;
+    int *keyBase;
+    int leafMax, internalMax;
+
+    int keyBytes(int n) const
+    {
+        return n * num_attrs * sizeof(int);
+    }
+
+#ifdef CPU_AVX2
+    __attribute__((target("avx2"))) static int countAVX2(const int *k, int n, int c, bool upper)
+    {
+        __m256i cv = _mm256_set1_epi32(c);
+        int count = 0, i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(k + i));
+            __m256i m = upper ? _mm256_cmpgt_epi32(v, cv) : _mm256_cmpgt_epi32(cv, v);
+            count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+        }
+        if (upper)
+            count = i - count;
+        for (; i < n; i++)
+            count += upper ? k[i] <= c : k[i] < c;
+        return count;
+    }
+#endif
+    // Number of the n sorted keys below c, or not above it if upper.
+    static int count(const int *k, int n, int c, bool upper)
+    {
+#ifdef CPU_AVX2
+        if (hasAVX2())
+            return countAVX2(k, n, c, upper);
+#endif
+        int i = 0;
+        while (i < n && (upper ? k[i] <= c : k[i] < c))
+            i++;
+        return i;
+    }
+    // Index of the first key above e if upper, else of the first key not below it.
+    int bound(const int *e, bool upper) const
+    {
+        int lo = 0, hi = size();
+        if (num_attrs == 1)
+        {
+            while (hi - lo > SEARCH_WINDOW)
+            {
+                int mid = (lo + hi) / 2;
+                if (keyBase[mid] < e[0] || (upper && keyBase[mid] == e[0]))
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo + count(keyBase + lo, hi - lo, e[0], upper);
+        }
+        while (lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+            int c = keyCompare(key(mid), e);
+            if (c == 1 || (upper && c == 0))
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
 public:
-    NodeHeader header;
-    std::vector<std::vector<int>> keys;
-    std::vector<int> children;
-    std::vector<RID> entries;
+    NodeHeader &header;
+
+    TreeNode(BufPageManager *bpm, int fileID, int pageID, int _num_attrs)
+        : guard(bpm, fileID, pageID), num_attrs(_num_attrs), header(*reinterpret_cast<NodeHeader *>(guard.data()))
+    {
+        keyBase = reinterpret_cast<int *>(reinterpret_cast<DataType>(guard.data()) + sizeof(NodeHeader));
+        leafMax = ::maxKeys(num_attrs, NodeType::LEAF);
+        internalMax = ::maxKeys(num_attrs, NodeType::INTERNAL);
+    }
+
+    // Capacity follows the node type, which a new page gets after it is loaded.
+    int maxKeys() const
+    {
+        return header.type == NodeType::LEAF ? leafMax : internalMax;
+    }
+
+    int minKeys() const
+    {
+        return maxKeys() / 2;
+    }
+
+    int size() const
+    {
+        return header.num_keys;
+    }
+
+    int *key(int i) const
+    {
+        return keyBase + i * num_attrs;
+    }
+
+    int *children() const
+    {
+        return keyBase + (maxKeys() + 1) * num_attrs;
+    }
+
+    RID *entries() const
+    {
+        return reinterpret_cast<RID *>(children());
+    }
+
+    int &child(int i) const
+    {
+        return children()[i];
+    }
+
+    RID &entry(int i) const
+    {
+        return entries()[i];
+    }
+
+    void setKey(int i, const int *k)
+    {
+        memcpy(key(i), k, keyBytes(1));
+    }
+
+    void markDirty()
+    {
+        guard.markDirty();
+    }
 
     /*
         1 if k1 < k2
         -1 if k1 > k2
         0 if k1 == k2
     */
-    int keyCompare(const std::vector<int> &k1, const std::vector<int> &k2)
+    int keyCompare(const int *k1, const int *k2) const
     {
-        assert(k1.size() == k2.size());
-
-        for (auto i = 0; i < k1.size(); i++)
+        for (auto i = 0; i < num_attrs; i++)
         {
             if (k1[i] < k2[i])
                 return 1;
@@ -36,9 +172,11 @@ public:
     bool searchChild(const int e, int &index)
     {
         int left = 0;
-        while (left < children.size())
+        int n = header.type == NodeType::INTERNAL ? size() + 1 : 0;
+        const int *c = children();
+        while (left < n)
         {
-            if (children[left] == e)
+            if (c[left] == e)
             {
                 index = left;
                 return true;
@@ -49,70 +187,106 @@ public:
         return false;
     }
 
-    bool searchKeyLowerBound(const std::vector<int> &e, int &index)
+    bool searchKeyLowerBound(const int *e, int &index)
     {
-        if (keys.size() <= 0)
-        {
-            index = 0;
-            return false;
-        }
-        int left = 0;
-        while (left < keys.size())
-        {
-            if (keyCompare(keys[left], e) <= 0)
-            {
-                index = left;
-                return keyCompare(keys[index], e) == 0;
-            }
-            left++;
-        }
-        index = left;
-        return false;
+        index = bound(e, false);
+        return index < size() && keyCompare(key(index), e) == 0;
+    }
+
+    bool searchKeyUpperBound(const int *e, int &index)
+    {
+        index = bound(e, true);
+        return index < size() && keyCompare(key(index), e) == 0;
+    }
+
+    // The child to descend into for e: the one left of the first key above e.
+    bool searchChild(const int *e, int &index)
+    {
+        index = bound(e, true);
+        return index > 0 && keyCompare(key(index - 1), e) == 0;
     }
 
-    bool searchKeyUpperBound(const std::vector<int> &e, int &index)
+    // Inserts key k at ki and child c at ci of an internal node.
+    void insertKeyChild(int ki, const int *k, int ci, int c)
     {
-        if (keys.size() <= 0)
+        int n = size();
+        memmove(key(ki + 1), key(ki), keyBytes(n - ki));
+        memmove(&children()[ci + 1], &children()[ci], (n + 1 - ci) * sizeof(int));
+        setKey(ki, k);
+        children()[ci] = c;
+        header.num_keys++;
+    }
+
+    void eraseKeyChild(int ki, int ci)
+    {
+        int n = size();
+        memmove(key(ki), key(ki + 1), keyBytes(n - ki - 1));
+        memmove(&children()[ci], &children()[ci + 1], (n - ci) * sizeof(int));
+        header.num_keys--;
+    }
+
+    void insertEntry(int i, const int *k, const RID &rid)
+    {
+        int n = size();
+        memmove(key(i + 1), key(i), keyBytes(n - i));
+        memmove(&entries()[i + 1], &entries()[i], (n - i) * sizeof(RID));
+        setKey(i, k);
+        entries()[i] = rid;
+        header.num_keys++;
+    }
+
+    void eraseEntry(int i)
+    {
+        int n = size();
+        memmove(key(i), key(i + 1), keyBytes(n - i - 1));
+        memmove(&entries()[i], &entries()[i + 1], (n - i - 1) * sizeof(RID));
+        header.num_keys--;
+    }
+
+    // Moves the keys from `from` on, with their RIDs or the children right of them, into the empty
+    // node dst. An internal node gives up key `from` as well; the caller carries it to the parent.
+    void moveTail(int from, TreeNode &dst)
+    {
+        int n = size();
+        if (header.type == NodeType::LEAF)
         {
-            index = 0;
-            return false;
+            memcpy(dst.key(0), key(from), keyBytes(n - from));
+            memcpy(&dst.entries()[0], &entries()[from], (n - from) * sizeof(RID));
+            dst.header.num_keys = n - from;
         }
-        int left = 0;
-        while (left < keys.size())
+        else
         {
-            if (keyCompare(keys[left], e) == -1)
-            {
-                index = left;
-                return keyCompare(keys[index], e) == 0;
-            }
-            left++;
+            memcpy(dst.key(0), key(from + 1), keyBytes(n - from - 1));
+            memcpy(&dst.children()[0], &children()[from + 1], (n - from) * sizeof(int));
+            dst.header.num_keys = n - from - 1;
         }
-        index = left;
-        return false;
+        header.num_keys = from;
     }
 
-    bool searchChild(const std::vector<int> &e, int &index)
+    // Puts everything in src in front of this node's keys; sep is the parent key between two internal nodes.
+    void prepend(const TreeNode &src, const int *sep)
     {
-        if (keys.size() <= 0 || keyCompare(e, keys[0]) == 1)
+        int n = size(), m = src.size();
+        if (header.type == NodeType::LEAF)
         {
-            index = 0;
-            return false;
+            memmove(key(m), key(0), keyBytes(n));
+            memmove(&entries()[m], &entries()[0], n * sizeof(RID));
+            memcpy(key(0), src.key(0), keyBytes(m));
+            memcpy(&entries()[0], &src.entries()[0], m * sizeof(RID));
+            header.num_keys = n + m;
         }
-        int left = 1;
-        while (left < keys.size())
+        else
         {
-            if (keyCompare(keys[left], e) == -1)
-            {
-                index = left;
-                return keyCompare(keys[index - 1], e) == 0;
-            }
-            left++;
+            memmove(key(m + 1), key(0), keyBytes(n));
+            memmove(&children()[m + 1], &children()[0], (n + 1) * sizeof(int));
+            memcpy(key(0), src.key(0), keyBytes(m));
+            setKey(m, sep);
+            memcpy(&children()[0], &src.children()[0], (m + 1) * sizeof(int));
+            header.num_keys = n + m + 1;
         }
-        index = left;
-        return keyCompare(keys[index - 1], e) == 0;
     }
 
-    bool insertKeyChild(const std::vector<int> &e, int child)
+    bool insertKeyChild(const int *e, int child)
     {
         int index;
         bool found = searchKeyUpperBound(e, index);
@@ -121,21 +295,19 @@ public:
         //     std::cout << "Duplicate key inserted." << std::endl;
         //     return false;
         // }
-        keys.insert(keys.begin() + index, e);
-        children.insert(children.begin() + index + 1, child);
+        insertKeyChild(index, e, index + 1, child);
         return true;
     }
 
-    bool insertKeyEntry(const std::vector<int> &e, const RID &rid)
+    bool insertKeyEntry(const int *e, const RID &rid)
     {
         int index;
         bool found = searchKeyUpperBound(e, index);
-        keys.insert(keys.begin() + index, e);
-        entries.insert(entries.begin() + index, rid);
+        insertEntry(index, e, rid);
         return true;
     }
 
-    bool deleteKeyEntry(const std::vector<int> &e, const RID &rid)
+    bool deleteKeyEntry(const int *e, const RID &rid)
     {
         int l_index, r_index;
         bool found = searchKeyLowerBound(e, l_index);
@@ -145,14 +317,16 @@ public:
             std::cout << "Non-existed key deleted." << std::endl;
             return false;
         }
-        for (int i = l_index; i < r_index; i++)
+        for (int i = l_index; i < r_index;)
         {
-            if (entries[i].equals(rid))
+            if (entries()[i].equals(rid))
             {
-                keys.erase(keys.begin() + i);
-                entries.erase(entries.begin() + i);
+                eraseEntry(i);
+                r_index--;
             }
+            else
+                i++;
         }
         return true;
     }
-};
\ No newline at end of file
+};
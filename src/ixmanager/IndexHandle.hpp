@@ -1,7 +1,6 @@
 #pragma once
 
 #include <memory>
-#include <map>
 #include <memory.h>
 #include "../recmanager/RID.hpp"
 #include "constants.h"
@@ -15,7 +14,6 @@ private:
     int fileID;
     BufPageManager *bpm;
     IndexHeader ih;
-    std::map<int, std::shared_ptr<TreeNode>> nodesMap;
 
 public:
     IndexHandle() {}
@@ -23,10 +21,8 @@ public:
     {
         fileID = _fileID;
         bpm = _bpm;
-        int index;
-        BufType b = bpm->getPage(fileID, 0, index);
-        memcpy(&ih, b, sizeof(IndexHeader));
-        bpm->access(index);
+        PageGuard header(bpm, fileID, 0, LATCH_SHARED);
+        memcpy(&ih, header.data(), sizeof(IndexHeader));
     }
     ~IndexHandle()
     {
@@ -39,6 +35,11 @@ public:
         return true;
     }
 
+    bool valid() const
+    {
+        return ih.magic == IX_MAGIC;
+    }
+
     bool getIndexHeader(IndexHeader &_ih) const
     {
         _ih = ih;
@@ -56,8 +57,9 @@ public:
         int pID = ih.rootPage;
         if (pID <= 0)
         {
-            std::shared_ptr<TreeNode> node(new TreeNode());
+            std::shared_ptr<TreeNode> node;
             getNewPage(pID);
+            loadTreeNode(pID, node);
             ih.height = 1;
             ih.rootPage = pID;
             saveIndexHeader();
@@ -67,7 +69,7 @@ public:
             node->header.parent = -1;
             node->header.rightSibling = -1;
             node->header.type = NodeType::LEAF;
-            saveTreeNode(pID, node);
+            saveTreeNode(node);
         }
 
         std::shared_ptr<TreeNode> node;
@@ -75,24 +77,24 @@ public:
         int index;
         while (node->header.type != NodeType::LEAF)
         {
-            node->searchChild(key, index);
-            pID = node->children[index];
+            node->searchChild(key.data(), index);
+            pID = node->child(index);
             loadTreeNode(pID, node);
         }
-        node->insertKeyEntry(key, rid);
-        saveTreeNode(pID, node);
+        node->insertKeyEntry(key.data(), rid);
+        saveTreeNode(node);
 
-        if (node->keys.size() > MAX_KEYS)
+        if (node->size() > node->maxKeys())
             splitLeafNode(node);
         return true;
     }
 
-    bool insertChildren(const std::vector<int> &child, int leftChildPID, int rightChildPID, std::shared_ptr<TreeNode> node, int pID)
+    bool insertChildren(const int *child, int leftChildPID, int rightChildPID, std::shared_ptr<TreeNode> node, int pID)
     {
         node->insertKeyChild(child, rightChildPID);
-        saveTreeNode(pID, node);
+        saveTreeNode(node);
 
-        if (node->keys.size() > MAX_KEYS)
+        if (node->size() > node->maxKeys())
             splitInternalNode(node);
 
         return true;
@@ -110,40 +112,40 @@ public:
         int index;
         while (node->header.type != NodeType::LEAF)
         {
-            node->searchChild(key, index);
-            pID = node->children[index];
+            node->searchChild(key.data(), index);
+            pID = node->child(index);
             loadTreeNode(pID, node);
         }
-        node->deleteKeyEntry(key, rid);
-        saveTreeNode(pID, node);
+        node->deleteKeyEntry(key.data(), rid);
+        saveTreeNode(node);
 
-        if (node->keys.size() >= MIN_KEYS || pID == ih.rootPage)
+        if (node->size() >= node->minKeys() || pID == ih.rootPage)
             return true;
 
         if (borrowKeyEntry(node, false))
         {
-            saveTreeNode(pID, node);
+            saveTreeNode(node);
             return true;
         }
 
         if (borrowKeyEntry(node, true))
         {
-            saveTreeNode(pID, node);
+            saveTreeNode(node);
             return true;
         }
 
         int deleted_child = node->header.leftSibling;
         if (mergeEntry(node, false))
         {
-            saveTreeNode(pID, node);
+            saveTreeNode(node);
             std::shared_ptr<TreeNode> p;
             loadTreeNode(node->header.parent, p);
             deleteKey(p, deleted_child);
-            saveTreeNode(node->header.parent, p);
+            saveTreeNode(p);
 
             if (ih.rootPage == pID)
                 node->header.parent = -1;
-            saveTreeNode(pID, node);
+            saveTreeNode(node);
             return true;
         }
 
@@ -152,14 +154,14 @@ public:
             std::shared_ptr<TreeNode> p;
             loadTreeNode(node->header.parent, p);
             deleteKey(p, pID);
-            saveTreeNode(node->header.parent, p);
+            saveTreeNode(p);
 
             if (ih.rootPage == node->header.rightSibling)
             {
                 std::shared_ptr<TreeNode> r;
                 loadTreeNode(node->header.rightSibling, r);
                 r->header.parent = -1;
-                saveTreeNode(node->header.rightSibling, r);
+                saveTreeNode(r);
             }
             return true;
         }
@@ -174,29 +176,28 @@ public:
         bool found = node->searchChild(child, index);
         assert(found);
 
-        node->keys.erase(node->keys.begin() + index);
-        node->children.erase(node->children.begin() + index);
+        node->eraseKeyChild(index, index);
 
-        if (node->keys.size() <= 0 && pID == ih.rootPage)
+        if (node->size() <= 0 && pID == ih.rootPage)
         {
             ih.height--;
-            ih.rootPage = node->children[0];
+            ih.rootPage = node->child(0);
             saveIndexHeader();
             return true;
         }
 
-        if (node->keys.size() >= MIN_KEYS)
+        if (node->size() >= node->minKeys())
             return true;
 
         if (borrowKeyChild(node, false))
         {
-            saveTreeNode(pID, node);
+            saveTreeNode(node);
             return true;
         }
 
         if (borrowKeyChild(node, true))
         {
-            saveTreeNode(pID, node);
+            saveTreeNode(node);
             return true;
         }
 
@@ -206,7 +207,7 @@ public:
             std::shared_ptr<TreeNode> p;
             loadTreeNode(node->header.parent, p);
             deleteKey(p, deleted_child);
-            saveTreeNode(node->header.parent, p);
+            saveTreeNode(p);
 
             if (ih.rootPage == pID)
                 node->header.parent = -1;
@@ -218,14 +219,14 @@ public:
             std::shared_ptr<TreeNode> p;
             loadTreeNode(node->header.parent, p);
             deleteKey(p, pID);
-            saveTreeNode(node->header.parent, p);
+            saveTreeNode(p);
 
             if (ih.rootPage == node->header.rightSibling)
             {
                 std::shared_ptr<TreeNode> r;
                 loadTreeNode(node->header.rightSibling, r);
                 r->header.parent = -1;
-                saveTreeNode(node->header.rightSibling, r);
+                saveTreeNode(r);
             }
             return true;
         }
@@ -233,25 +234,20 @@ public:
         return false;
     }
 
-    bool forcePages() {}
+    bool forcePages()
+    {
+        return true;
+    }
 
     bool getNewPage(int &pageID)
     {
         pageID = ih.numPages;
-        int index;
-        bpm->allocPage(fileID, pageID, index, false);
+        PageGuard page(bpm, fileID, pageID, LATCH_EXCLUSIVE);
+        memset(page.data(), 0, sizeof(NodeHeader));
+        page.markDirty();
+        page.release();
         ih.numPages++;
-        BufType b = bpm->getPage(fileID, 0, index);
-        DataType d = reinterpret_cast<DataType>(b);
-        memcpy(d, &ih, sizeof(ih));
-        bpm->markDirty(index);
-        bpm->writeBack(index);
-
-        b = bpm->getPage(fileID, pageID, index);
-        d = reinterpret_cast<DataType>(b);
-        memset(d, 0, sizeof(NodeHeader));
-        bpm->markDirty(index);
-        bpm->writeBack(index);
+        saveIndexHeader();
         return true;
     }
 
@@ -271,15 +267,15 @@ public:
             std::shared_ptr<TreeNode> node;
             loadTreeNode(pID, node);
             int index;
-            bool found = node->searchChild(key, index);
+            bool found = node->searchChild(key.data(), index);
             if (node->header.type == NodeType::INTERNAL)
             {
-                return searchEntry(node->children[index], key, pageID, slotID);
+                return searchEntry(node->child(index), key, pageID, slotID);
             }
             else
             {
                 pageID = pID;
-                node->searchKeyLowerBound(key, slotID);
+                node->searchKeyLowerBound(key.data(), slotID);
                 return found;
             }
         }
@@ -288,123 +284,57 @@ public:
     bool getMostLeft(int &pageID)
     {
         int pID = ih.rootPage;
+        if (pID <= 0)
+        {
+            pageID = -1;
+            return false;
+        }
         std::shared_ptr<TreeNode> t;
         loadTreeNode(pID, t);
         while (t->header.type == NodeType::INTERNAL)
         {
-            pID = t->children[0];
+            pID = t->child(0);
             loadTreeNode(pID, t);
         }
         pageID = pID;
         return true;
     }
 
-    bool loadTreeNode(const int pID, std::shared_ptr<TreeNode> &node)
+    // Collects the leaves following `leaf` under the same parent, in key order,
+    // so that a leaf walk can prefetch them ahead of time.
+    bool getLeafRun(const std::shared_ptr<TreeNode> &leaf, std::vector<int> &pages)
     {
-        auto it = nodesMap.find(pID);
-        if (it != nodesMap.end() && it->second.use_count() != 0)
-        {
-            node = it->second;
-            return true;
-        }
-        node = std::shared_ptr<TreeNode>(new TreeNode());
-        nodesMap[pID] = node;
-
+        pages.clear();
+        if (leaf->header.parent <= 0)
+            return false;
+        std::shared_ptr<TreeNode> p;
+        loadTreeNode(leaf->header.parent, p);
         int index;
-        BufType b = bpm->getPage(fileID, pID, index);
-        DataType d = reinterpret_cast<DataType>(b);
+        if (!p->searchChild(leaf->header.pageID, index))
+            return false;
+        pages.assign(&p->child(index + 1), &p->child(p->size()) + 1);
+        return !pages.empty();
+    }
 
-        memcpy(&node->header, d, sizeof(NodeHeader));
-        if (node->header.type == NodeType::INTERNAL)
-        {
-            for (auto i = 0; i <= node->header.num_keys && node->header.num_keys > 0; i++)
-            {
-                int child;
-                memcpy(&child, &d[sizeof(NodeHeader) + i * (4 + 4 * ih.num_attrs)], 4);
-                node->children.push_back(child);
-
-                if (i < node->header.num_keys)
-                {
-                    std::vector<int> key;
-                    for (auto j = 0; j < ih.num_attrs; j++)
-                    {
-                        int tmp;
-                        memcpy(&tmp, &d[sizeof(NodeHeader) + i * (4 + 4 * ih.num_attrs) + 4 + j * 4], 4);
-                        key.push_back(tmp);
-                    }
-
-                    node->keys.push_back(key);
-                }
-            }
-        }
-        else
-        {
-            for (auto i = 0; i < node->header.num_keys && node->header.num_keys > 0; i++)
-            {
-                RID entry;
-                memcpy(&entry, &d[sizeof(NodeHeader) + i * (sizeof(RID) + 4 * ih.num_attrs)], sizeof(RID));
-                node->entries.push_back(entry);
-
-                std::vector<int> key;
-                for (auto j = 0; j < ih.num_attrs; j++)
-                {
-                    int tmp;
-                    memcpy(&tmp, &d[sizeof(NodeHeader) + i * (sizeof(RID) + 4 * ih.num_attrs) + sizeof(RID) + j * 4], 4);
-                    key.push_back(tmp);
-                }
-
-                node->keys.push_back(key);
-            }
-        }
+    // Pins the node's page; the node is read and changed in the frame until the last reference goes.
+    bool loadTreeNode(const int pID, std::shared_ptr<TreeNode> &node)
+    {
+        node = std::make_shared<TreeNode>(bpm, fileID, pID, ih.num_attrs);
         return true;
     }
 
-    bool saveTreeNode(const int pID, std::shared_ptr<TreeNode> node)
+    bool saveTreeNode(std::shared_ptr<TreeNode> node)
     {
-        int index;
-        BufType b = bpm->getPage(fileID, pID, index);
-        DataType d = reinterpret_cast<DataType>(b);
-
-        node->header.num_keys = node->keys.size();
-        memcpy(d, &node->header, sizeof(NodeHeader));
-        if (node->header.type == NodeType::INTERNAL)
-        {
-            for (auto i = 0; i <= node->header.num_keys && node->header.num_keys > 0; i++)
-            {
-                memcpy(&d[sizeof(NodeHeader) + i * (4 + 4 * ih.num_attrs)], &node->children[i], 4);
-
-                for (auto j = 0; j < ih.num_attrs && i < node->header.num_keys; j++)
-                {
-                    memcpy(&d[sizeof(NodeHeader) + i * (4 + 4 * ih.num_attrs) + 4 + j * 4], &node->keys[i][j], 4);
-                }
-            }
-        }
-        else
-        {
-            for (auto i = 0; i < node->header.num_keys && node->header.num_keys > 0; i++)
-            {
-                memcpy(&d[sizeof(NodeHeader) + i * (sizeof(RID) + 4 * ih.num_attrs)], &node->entries[i], sizeof(RID));
-
-                for (auto j = 0; j < ih.num_attrs && i < node->header.num_keys; j++)
-                {
-                    memcpy(&d[sizeof(NodeHeader) + i * (sizeof(RID) + 4 * ih.num_attrs) + sizeof(RID) + j * 4], &node->keys[i][j], 4);
-                }
-            }
-        }
-        bpm->markDirty(index);
-        bpm->writeBack(index);
+        node->markDirty();
         return true;
     }
 
+    // The header lives in the cached page 0 and is written back lazily with the other dirty pages.
     bool saveIndexHeader()
     {
-        int index;
-        BufType b = bpm->getPage(fileID, 0, index);
-        DataType d = reinterpret_cast<DataType>(b);
-
-        memcpy(d, &ih, sizeof(IndexHeader));
-        bpm->markDirty(index);
-        bpm->writeBack(index);
+        PageGuard header(bpm, fileID, 0, LATCH_EXCLUSIVE);
+        memcpy(header.data(), &ih, sizeof(IndexHeader));
+        header.markDirty();
         return true;
     }
 
@@ -414,44 +344,40 @@ public:
         int surrogatePID;
         getNewPage(surrogatePID);
 
-        std::shared_ptr<TreeNode> surrogateNode(new TreeNode());
-        saveTreeNode(surrogatePID, surrogateNode);
-        surrogateNode.reset();
+        std::shared_ptr<TreeNode> surrogateNode;
         loadTreeNode(surrogatePID, surrogateNode);
 
         surrogateNode->header.type = NodeType::LEAF;
         surrogateNode->header.pageID = surrogatePID;
         surrogateNode->header.leftSibling = pID;
         surrogateNode->header.rightSibling = node->header.rightSibling;
-        surrogateNode->keys.insert(surrogateNode->keys.end(), node->keys.begin() + MIN_KEYS, node->keys.end());
-        surrogateNode->entries.insert(surrogateNode->entries.end(), node->entries.begin() + MIN_KEYS, node->entries.end());
-        node->keys.resize(MIN_KEYS);
-        node->entries.resize(MIN_KEYS);
+        node->moveTail(node->minKeys(), *surrogateNode);
 
         if (node->header.rightSibling > 0)
         {
             std::shared_ptr<TreeNode> tmp;
             loadTreeNode(node->header.rightSibling, tmp);
             tmp->header.leftSibling = surrogatePID;
-            saveTreeNode(node->header.rightSibling, tmp);
+            saveTreeNode(tmp);
         }
         node->header.rightSibling = surrogatePID;
 
         if (node->header.parent > 0)
         {
             surrogateNode->header.parent = node->header.parent;
-            saveTreeNode(surrogatePID, surrogateNode);
-            saveTreeNode(pID, node);
+            saveTreeNode(surrogateNode);
+            saveTreeNode(node);
 
             std::shared_ptr<TreeNode> parentNode;
             loadTreeNode(node->header.parent, parentNode);
-            insertChildren(surrogateNode->keys.front(), pID, surrogatePID, parentNode, node->header.parent);
+            insertChildren(surrogateNode->key(0), pID, surrogatePID, parentNode, node->header.parent);
         }
         else
         {
             int parentPID;
             getNewPage(parentPID);
-            std::shared_ptr<TreeNode> parent(new TreeNode());
+            std::shared_ptr<TreeNode> parent;
+            loadTreeNode(parentPID, parent);
             parent->header.pageID = parentPID;
             parent->header.num_keys = 1;
             parent->header.parent = -1;
@@ -462,13 +388,13 @@ public:
             surrogateNode->header.parent = parentPID;
             node->header.parent = parentPID;
 
-            parent->keys.push_back(surrogateNode->keys.front());
-            parent->children.push_back(pID);
-            parent->children.push_back(surrogatePID);
+            parent->setKey(0, surrogateNode->key(0));
+            parent->child(0) = pID;
+            parent->child(1) = surrogatePID;
 
-            saveTreeNode(parentPID, parent);
-            saveTreeNode(surrogatePID, surrogateNode);
-            saveTreeNode(pID, node);
+            saveTreeNode(parent);
+            saveTreeNode(surrogateNode);
+            saveTreeNode(node);
 
             ih.height++;
             ih.rootPage = parentPID;
@@ -483,55 +409,47 @@ public:
         int surrogatePID;
         getNewPage(surrogatePID);
 
-        std::shared_ptr<TreeNode> surrogateNode(new TreeNode());
-        saveTreeNode(surrogatePID, surrogateNode);
-        surrogateNode.reset();
+        std::shared_ptr<TreeNode> surrogateNode;
         loadTreeNode(surrogatePID, surrogateNode);
 
         surrogateNode->header.type = NodeType::INTERNAL;
         surrogateNode->header.pageID = surrogatePID;
         surrogateNode->header.rightSibling = node->header.rightSibling;
-        for (auto i = MIN_KEYS + 1; i <= MAX_KEYS; i++)
+        std::vector<int> carryKey(node->key(node->minKeys()), node->key(node->minKeys() + 1));
+        node->moveTail(node->minKeys(), *surrogateNode);
+        for (auto i = 0; i <= surrogateNode->size(); i++)
         {
-            surrogateNode->keys.push_back(node->keys[i]);
-        }
-        for (auto i = MIN_KEYS + 1; i <= MAX_KEYS + 1; i++)
-        {
-            surrogateNode->children.push_back(node->children[i]);
-
             std::shared_ptr<TreeNode> childNode;
-            loadTreeNode(node->children[i], childNode);
+            loadTreeNode(surrogateNode->child(i), childNode);
             childNode->header.parent = surrogatePID;
-            saveTreeNode(node->children[i], childNode);
+            saveTreeNode(childNode);
         }
-        std::vector<int> carryKey = node->keys[MIN_KEYS];
-        node->keys.resize(MIN_KEYS);
-        node->children.resize(MIN_KEYS + 1);
 
         if (node->header.rightSibling > 0)
         {
             std::shared_ptr<TreeNode> tmp;
             loadTreeNode(node->header.rightSibling, tmp);
             tmp->header.leftSibling = surrogatePID;
-            saveTreeNode(node->header.rightSibling, tmp);
+            saveTreeNode(tmp);
         }
         node->header.rightSibling = surrogatePID;
 
         if (node->header.parent > 0)
         {
             surrogateNode->header.parent = node->header.parent;
-            saveTreeNode(surrogatePID, surrogateNode);
-            saveTreeNode(pID, node);
+            saveTreeNode(surrogateNode);
+            saveTreeNode(node);
 
             std::shared_ptr<TreeNode> parentNode;
             loadTreeNode(node->header.parent, parentNode);
-            insertChildren(carryKey, pID, surrogatePID, parentNode, node->header.parent);
+            insertChildren(carryKey.data(), pID, surrogatePID, parentNode, node->header.parent);
         }
         else
         {
             int parentPID;
             getNewPage(parentPID);
-            std::shared_ptr<TreeNode> parent(new TreeNode());
+            std::shared_ptr<TreeNode> parent;
+            loadTreeNode(parentPID, parent);
             parent->header.pageID = parentPID;
             parent->header.num_keys = 1;
             parent->header.parent = -1;
@@ -542,13 +460,13 @@ public:
             surrogateNode->header.parent = parentPID;
             node->header.parent = parentPID;
 
-            parent->keys.push_back(carryKey);
-            parent->children.push_back(pID);
-            parent->children.push_back(surrogatePID);
+            parent->setKey(0, carryKey.data());
+            parent->child(0) = pID;
+            parent->child(1) = surrogatePID;
 
-            saveTreeNode(parentPID, parent);
-            saveTreeNode(surrogatePID, surrogateNode);
-            saveTreeNode(pID, node);
+            saveTreeNode(parent);
+            saveTreeNode(surrogateNode);
+            saveTreeNode(node);
 
             ih.height++;
             ih.rootPage = parentPID;
@@ -559,46 +477,40 @@ public:
 
     bool borrowKeyEntry(std::shared_ptr<TreeNode> node, bool fromRight)
     {
-        int pID = node->header.pageID;
         int lenderPID = fromRight ? node->header.rightSibling : node->header.leftSibling;
         if (lenderPID <= 0)
             return false;
         std::shared_ptr<TreeNode> lenderNode;
         loadTreeNode(lenderPID, lenderNode);
 
-        assert(lenderNode->keys.size() >= MIN_KEYS && lenderNode->keys.size() <= MAX_KEYS);
+        assert(lenderNode->size() >= lenderNode->minKeys() && lenderNode->size() <= lenderNode->maxKeys());
 
-        if (lenderNode->keys.size() == MIN_KEYS)
+        if (lenderNode->size() == lenderNode->minKeys())
             return false;
         if (fromRight)
         {
-            node->keys.push_back(lenderNode->keys[0]);
-            node->entries.push_back(lenderNode->entries[0]);
-
-            lenderNode->keys.erase(lenderNode->keys.begin());
-            lenderNode->entries.erase(lenderNode->entries.begin());
+            node->insertEntry(node->size(), lenderNode->key(0), lenderNode->entry(0));
+            lenderNode->eraseEntry(0);
 
             std::shared_ptr<TreeNode> p;
             loadTreeNode(node->header.parent, p);
-            changeParentChild(p, node->keys.back(), lenderNode->keys.front());
-            saveTreeNode(node->header.parent, p);
+            changeParentChild(p, node->key(node->size() - 1), lenderNode->key(0));
+            saveTreeNode(p);
         }
         else
         {
-            node->keys.insert(node->keys.begin(), lenderNode->keys.back());
-            node->entries.insert(node->entries.begin(), lenderNode->entries.back());
-
-            lenderNode->keys.pop_back();
-            lenderNode->entries.pop_back();
+            int last = lenderNode->size() - 1;
+            node->insertEntry(0, lenderNode->key(last), lenderNode->entry(last));
+            lenderNode->eraseEntry(last);
 
             std::shared_ptr<TreeNode> p;
             loadTreeNode(lenderNode->header.parent, p);
-            changeParentChild(p, lenderNode->keys.back(), node->keys.front());
-            saveTreeNode(lenderNode->header.parent, p);
+            changeParentChild(p, lenderNode->key(last - 1), node->key(0));
+            saveTreeNode(p);
         }
 
-        saveTreeNode(pID, node);
-        saveTreeNode(lenderPID, lenderNode);
+        saveTreeNode(node);
+        saveTreeNode(lenderNode);
 
         return true;
     }
@@ -612,9 +524,9 @@ public:
         std::shared_ptr<TreeNode> lenderNode;
         loadTreeNode(lenderPID, lenderNode);
 
-        assert(lenderNode->keys.size() >= MIN_KEYS && lenderNode->keys.size() <= MAX_KEYS);
+        assert(lenderNode->size() >= lenderNode->minKeys() && lenderNode->size() <= lenderNode->maxKeys());
 
-        if (lenderNode->keys.size() == MIN_KEYS)
+        if (lenderNode->size() == lenderNode->minKeys())
             return false;
         if (fromRight)
         {
@@ -623,20 +535,18 @@ public:
             int index;
             p->searchChild(pID, index);
 
-            node->keys.push_back(p->keys[index]);
-            node->children.push_back(lenderNode->children[0]);
+            node->insertKeyChild(node->size(), p->key(index), node->size() + 1, lenderNode->child(0));
 
             std::shared_ptr<TreeNode> childNode;
-            loadTreeNode(lenderNode->children[0], childNode);
+            loadTreeNode(lenderNode->child(0), childNode);
             childNode->header.parent = pID;
-            saveTreeNode(lenderNode->children[0], childNode);
+            saveTreeNode(childNode);
 
-            changeParentChild(p, p->keys[index], lenderNode->keys[0]);
+            changeParentChild(p, p->key(index), lenderNode->key(0));
 
-            lenderNode->keys.erase(lenderNode->keys.begin());
-            lenderNode->children.erase(lenderNode->children.begin());
+            lenderNode->eraseKeyChild(0, 0);
 
-            saveTreeNode(node->header.parent, p);
+            saveTreeNode(p);
         }
         else
         {
@@ -645,40 +555,39 @@ public:
             int index;
             p->searchChild(lenderPID, index);
 
-            node->keys.insert(node->keys.begin(), p->keys[index]);
-            node->children.insert(node->children.begin(), lenderNode->children.back());
+            int last = lenderNode->size();
+            node->insertKeyChild(0, p->key(index), 0, lenderNode->child(last));
 
             std::shared_ptr<TreeNode> childNode;
-            loadTreeNode(lenderNode->children.back(), childNode);
+            loadTreeNode(lenderNode->child(last), childNode);
             childNode->header.parent = pID;
-            saveTreeNode(lenderNode->children.back(), childNode);
+            saveTreeNode(childNode);
 
-            changeParentChild(p, p->keys[index], lenderNode->keys.back());
+            changeParentChild(p, p->key(index), lenderNode->key(last - 1));
 
-            lenderNode->keys.pop_back();
-            lenderNode->children.pop_back();
+            lenderNode->eraseKeyChild(last - 1, last);
 
-            saveTreeNode(node->header.parent, p);
+            saveTreeNode(p);
         }
 
-        saveTreeNode(pID, node);
-        saveTreeNode(lenderPID, lenderNode);
+        saveTreeNode(node);
+        saveTreeNode(lenderNode);
 
         return true;
     }
 
-    bool changeParentChild(std::shared_ptr<TreeNode> parent, const std::vector<int> &o, const std::vector<int> &n)
+    bool changeParentChild(std::shared_ptr<TreeNode> parent, const int *o, const int *n)
     {
         int index;
         bool found = parent->searchChild(o, index);
         // assert(found);
-        parent->keys[index - 1] = n;
-        if (index == parent->keys.size() && parent->header.parent > 0)
+        parent->setKey(index - 1, n);
+        if (index == parent->size() && parent->header.parent > 0)
         {
             std::shared_ptr<TreeNode> p;
             loadTreeNode(parent->header.parent, p);
             changeParentChild(p, o, n);
-            saveTreeNode(parent->header.parent, p);
+            saveTreeNode(p);
         }
         return true;
     }
@@ -696,8 +605,7 @@ public:
 
         if (withRight)
         {
-            siblingNode->keys.insert(siblingNode->keys.begin(), node->keys.begin(), node->keys.end());
-            siblingNode->entries.insert(siblingNode->entries.begin(), node->entries.begin(), node->entries.end());
+            siblingNode->prepend(*node, nullptr);
 
             siblingNode->header.leftSibling = node->header.leftSibling;
             if (node->header.leftSibling > 0)
@@ -705,13 +613,12 @@ public:
                 std::shared_ptr<TreeNode> l;
                 loadTreeNode(node->header.leftSibling, l);
                 l->header.rightSibling = siblingPID;
-                saveTreeNode(node->header.leftSibling, l);
+                saveTreeNode(l);
             }
         }
         else
         {
-            node->keys.insert(node->keys.begin(), siblingNode->keys.begin(), siblingNode->keys.end());
-            node->entries.insert(node->entries.begin(), siblingNode->entries.begin(), siblingNode->entries.end());
+            node->prepend(*siblingNode, nullptr);
 
             node->header.leftSibling = siblingNode->header.leftSibling;
             if (siblingNode->header.leftSibling > 0)
@@ -719,11 +626,11 @@ public:
                 std::shared_ptr<TreeNode> ll;
                 loadTreeNode(siblingNode->header.leftSibling, ll);
                 ll->header.rightSibling = pID;
-                saveTreeNode(siblingNode->header.leftSibling, ll);
+                saveTreeNode(ll);
             }
         }
 
-        saveTreeNode(siblingPID, siblingNode);
+        saveTreeNode(siblingNode);
         return true;
     }
 
@@ -745,16 +652,15 @@ public:
         assert(found);
         if (withRight)
         {
-            siblingNode->keys.insert(siblingNode->keys.begin(), p->keys[index]);
-            siblingNode->keys.insert(siblingNode->keys.begin(), node->keys.begin(), node->keys.end());
-            siblingNode->children.insert(siblingNode->children.begin(), node->children.begin(), node->children.end());
+            siblingNode->prepend(*node, p->key(index));
 
-            for (auto childPID : node->children)
+            for (auto i = 0; i <= node->size(); i++)
             {
+                int childPID = node->child(i);
                 std::shared_ptr<TreeNode> c;
                 loadTreeNode(childPID, c);
                 c->header.parent = siblingPID;
-                saveTreeNode(childPID, c);
+                saveTreeNode(c);
             }
 
             siblingNode->header.leftSibling = node->header.leftSibling;
@@ -763,21 +669,20 @@ public:
                 std::shared_ptr<TreeNode> l;
                 loadTreeNode(node->header.leftSibling, l);
                 l->header.rightSibling = siblingPID;
-                saveTreeNode(node->header.leftSibling, l);
+                saveTreeNode(l);
             }
         }
         else
         {
-            node->keys.insert(node->keys.begin(), p->keys[index]);
-            node->keys.insert(node->keys.begin(), siblingNode->keys.begin(), siblingNode->keys.end());
-            node->children.insert(node->children.begin(), siblingNode->children.begin(), siblingNode->children.end());
+            node->prepend(*siblingNode, p->key(index));
 
-            for (auto childPID : siblingNode->children)
+            for (auto i = 0; i <= siblingNode->size(); i++)
             {
+                int childPID = siblingNode->child(i);
                 std::shared_ptr<TreeNode> c;
                 loadTreeNode(childPID, c);
                 c->header.parent = pID;
-                saveTreeNode(childPID, c);
+                saveTreeNode(c);
             }
 
             node->header.leftSibling = siblingNode->header.leftSibling;
@@ -786,11 +691,11 @@ public:
                 std::shared_ptr<TreeNode> ll;
                 loadTreeNode(siblingNode->header.leftSibling, ll);
                 ll->header.rightSibling = pID;
-                saveTreeNode(siblingNode->header.leftSibling, ll);
+                saveTreeNode(ll);
             }
         }
 
-        saveTreeNode(siblingPID, siblingNode);
+        saveTreeNode(siblingNode);
         return true;
     }
 };
\ No newline at end of file
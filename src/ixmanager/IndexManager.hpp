@@ -7,6 +7,7 @@
 #include "IndexHandle.hpp"
 #include "../fileio/FileManager.h"
 #include "../bufmanager/BufPageManager.h"
+#include "../bufmanager/FileCache.h"
 #include "constants.h"
 
 class IndexManager
@@ -15,6 +16,7 @@ private:
     FileManager *fm;
     BufPageManager *bpm;
     std::map<std::string, int> openedMap;
+    FileCache cache;
 
 public:
     IndexManager() {}
@@ -22,6 +24,7 @@ public:
     {
         fm = _fm;
         bpm = _bpm;
+        cache = FileCache(fm, bpm);
     }
     ~IndexManager()
     {
@@ -34,6 +37,7 @@ public:
         string fn_ix = filename;
         for (auto in : indexNo)
             fn_ix += '.' + to_string(in);
+        cache.drop(fn_ix);
         fm->createFile(fn_ix.c_str());
         int fileID;
         fm->openFile(fn_ix.c_str(), fileID);
@@ -52,9 +56,10 @@ public:
         ih.height = 0;
         ih.type = attrType;
         ih.num_attrs = attrLength / 4;
+        ih.magic = IX_MAGIC;
         memcpy(d, &ih, sizeof(IndexHeader));
         bpm->markDirty(index);
-        bpm->writeBack(index);
+        cache.put(fn_ix, fileID);
         return true;
     }
 
@@ -63,10 +68,25 @@ public:
         string fn_ix = filename;
         for (auto in : indexNo)
             fn_ix += '.' + to_string(in);
+        cache.drop(fn_ix);
+        auto it = openedMap.find(fn_ix);
+        if (it != openedMap.end())
+        {
+            bpm->dropFile(it->second);
+            fm->closeFile(it->second);
+            openedMap.erase(it);
+        }
         remove(fn_ix.c_str());
         return true;
     }
 
+    // Forgets every kept-open index file under `prefix`, e.g. before removing a database directory.
+    bool destroyIndexes(const std::string prefix)
+    {
+        cache.dropPrefix(prefix);
+        return true;
+    }
+
     bool openIndex(const std::string filename, std::vector<int> &indexNo, IndexHandle &indexHandle)
     {
         string fn_ix = filename;
@@ -76,9 +96,17 @@ public:
         if (it != openedMap.end())
             return false;
         int fileID;
-        fm->openFile(fn_ix.c_str(), fileID);
+        if (!cache.take(fn_ix, fileID))
+            fm->openFile(fn_ix.c_str(), fileID);
+        IndexHandle handle(fileID, bpm);
+        // An index in an older node layout is refused until it is rebuilt.
+        if (!handle.valid())
+        {
+            cache.put(fn_ix, fileID);
+            return false;
+        }
         openedMap[fn_ix] = fileID;
-        indexHandle = IndexHandle(fileID, bpm);
+        indexHandle = handle;
         return true;
     }
 
@@ -90,8 +118,7 @@ public:
         auto it = openedMap.find(fn_ix);
         if (it == openedMap.end())
             return false;
-        bpm->close();
-        fm->closeFile(it->second);
+        cache.put(fn_ix, it->second);
         openedMap.erase(it);
         return true;
     }
@@ -14,6 +14,8 @@ private:
     std::vector<int> keys;
     int pageID, slotID;
     std::shared_ptr<TreeNode> curNode;
+    ReadAhead ra;
+    int leafIdx;
 
 public:
     IndexScan()
@@ -34,6 +36,8 @@ public:
         this->keys = keys;
         slotID = 0;
         curNode = nullptr;
+        ra = ReadAhead();
+        leafIdx = 0;
 
         switch (this->op)
         {
@@ -61,10 +65,10 @@ public:
         {
             std::shared_ptr<TreeNode> tmp;
             handle.loadTreeNode(pageID, tmp);
-            while (tmp->keyCompare(tmp->keys[slotID], keys) != -1)
+            while (tmp->keyCompare(tmp->key(slotID), keys.data()) != -1)
             {
                 slotID++;
-                if (slotID == tmp->keys.size())
+                if (slotID == tmp->size())
                 {
                     pageID = tmp->header.rightSibling;
                     slotID = 0;
@@ -79,10 +83,10 @@ public:
         {
             std::shared_ptr<TreeNode> tmp;
             handle.loadTreeNode(pageID, tmp);
-            while (tmp->keyCompare(tmp->keys[slotID], std::vector<int>(keys.begin(), keys.begin() + ih.num_attrs)) != -1)
+            while (tmp->keyCompare(tmp->key(slotID), keys.data()) != -1)
             {
                 slotID++;
-                if (slotID == tmp->keys.size())
+                if (slotID == tmp->size())
                 {
                     pageID = tmp->header.rightSibling;
                     slotID = 0;
@@ -93,6 +97,7 @@ public:
                 }
             }
         }
+        return true;
     }
 
     bool getNextEntry(RID &rid)
@@ -103,70 +108,82 @@ public:
         {
             handle.loadTreeNode(pageID, curNode);
         }
-        if (slotID == curNode->keys.size())
+        if (slotID == curNode->size())
         {
             pageID = curNode->header.rightSibling;
             if (pageID <= 0)
                 return false;
+            // prefetch the following leaves under the same parent
+            if (leafIdx + 1 < (int)ra.pages.size() && ra.pages[leafIdx + 1] == pageID)
+                leafIdx++;
+            else
+            {
+                std::vector<int> pages;
+                handle.getLeafRun(curNode, pages);
+                bpm->readList(ra, fileID, pages);
+                leafIdx = 0;
+            }
+            if (!ra.pages.empty() && ra.pages[leafIdx] == pageID)
+                bpm->readAhead(ra, leafIdx);
             handle.loadTreeNode(pageID, curNode);
             slotID = 0;
         }
         switch (this->op)
         {
         case CompOp::L:
-            if (curNode->keyCompare(curNode->keys[slotID], keys) == 1)
+            if (curNode->keyCompare(curNode->key(slotID), keys.data()) == 1)
             {
-                rid = curNode->entries[slotID];
+                rid = curNode->entry(slotID);
                 slotID++;
                 return true;
             }
             break;
         case CompOp::LE:
-            if (curNode->keyCompare(curNode->keys[slotID], keys) >= 0)
+            if (curNode->keyCompare(curNode->key(slotID), keys.data()) >= 0)
             {
-                rid = curNode->entries[slotID];
+                rid = curNode->entry(slotID);
                 slotID++;
                 return true;
             }
             break;
         case CompOp::G:
-            if (curNode->keyCompare(curNode->keys[slotID], keys) == -1)
+            if (curNode->keyCompare(curNode->key(slotID), keys.data()) == -1)
             {
-                rid = curNode->entries[slotID];
+                rid = curNode->entry(slotID);
                 slotID++;
                 return true;
             }
             break;
         case CompOp::GE:
-            if (curNode->keyCompare(curNode->keys[slotID], keys) <= 0)
+            if (curNode->keyCompare(curNode->key(slotID), keys.data()) <= 0)
             {
-                rid = curNode->entries[slotID];
+                rid = curNode->entry(slotID);
                 slotID++;
                 return true;
             }
             break;
         case CompOp::E:
-            if (curNode->keyCompare(curNode->keys[slotID], keys) == 0)
+            if (curNode->keyCompare(curNode->key(slotID), keys.data()) == 0)
             {
-                rid = curNode->entries[slotID];
+                rid = curNode->entry(slotID);
                 slotID++;
                 return true;
             }
             break;
         case CompOp::BETWEEN:
         case CompOp::BETWEENL:
-            if (curNode->keyCompare(curNode->keys[slotID], std::vector<int>(keys.begin() + ih.num_attrs, keys.end())) == 1)
+            if (curNode->keyCompare(curNode->key(slotID), keys.data() + ih.num_attrs) == 1)
             {
-                rid = curNode->entries[slotID];
+                rid = curNode->entry(slotID);
                 slotID++;
                 return true;
             }
             break;
         case CompOp::BETWEENR:
         case CompOp::BETWEENLR:
-            if (curNode->keyCompare(curNode->keys[slotID], std::vector<int>(keys.begin() + ih.num_attrs, keys.end())) >= 0)
+            if (curNode->keyCompare(curNode->key(slotID), keys.data() + ih.num_attrs) >= 0)
             {
-                rid = curNode->entries[slotID];
+                rid = curNode->entry(slotID);
                 slotID++;
                 return true;
             }
@@ -3,6 +3,10 @@
 #include "../recmanager/RID.hpp"
 #include "../recmanager/constants.h"
 
+// Written by createIndex and changed whenever the node layout changes. Index files without it
+// are from an older layout and get rebuilt from their table when the database is opened.
+#define IX_MAGIC 0x32305849
+
 struct IndexHeader
 {
     int numPages;
@@ -10,13 +14,9 @@ struct IndexHeader
     int height;
     AttrType type;
     int num_attrs;
+    unsigned int magic;
 };
 
-#define IX_M 100
-
-#define MAX_KEYS IX_M
-#define MIN_KEYS IX_M / 2
-
 enum NodeType
 {
     INTERNAL,
@@ -31,4 +31,15 @@ struct NodeHeader
     int parent;
     int leftSibling;
     int rightSibling;
-};
\ No newline at end of file
+};
+
+// Keys a node holds before it splits, derived from the page size and key width. The page keeps
+// room for one key past this, held between an insert and the split that follows; an internal
+// node has one child more than it has keys.
+inline int maxKeys(int num_attrs, NodeType type)
+{
+    int keyBytes = num_attrs * sizeof(int);
+    if (type == NodeType::LEAF)
+        return (PAGE_SIZE - sizeof(NodeHeader)) / (keyBytes + sizeof(RID)) - 1;
+    return (PAGE_SIZE - sizeof(NodeHeader) - sizeof(int)) / (keyBytes + sizeof(int)) - 1;
+}
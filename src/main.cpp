@@ -69,13 +69,22 @@ std::string getSql()
     return sql;
 }
 
-int main(int, const char **)
+int main(int argc, const char **argv)
 {
     std::string sSQL;
+    int bufferPages = 0;
+    for (int i = 1; i + 1 < argc; i++)
+        if (std::string(argv[i]) == "--buffer-pages")
+            bufferPages = atoi(argv[++i]);
+
+    // 默认每条语句结束时把写过的页面落盘，MINISQL_SYNC=off时只在退出时落盘
+    const char *syncEnv = getenv("MINISQL_SYNC");
+    bool syncEachStatement = !(syncEnv != NULL && std::string(syncEnv) == "off");
 
     MyBitMap::initConst();
     FileManager *fm = new FileManager();
-    BufPageManager *bpm = new BufPageManager(fm);
+    BufPageManager *bpm = new BufPageManager(fm, bufferPages);
+    bpm->startFlusher();
     RecordManager *rm = new RecordManager(fm, bpm);
     IndexManager *im = new IndexManager(fm, bpm);
     SystemManager *sm = new SystemManager(rm, im);
@@ -99,11 +108,21 @@ int main(int, const char **)
             std::cerr << e.what() << '\n';
             std::cout << "Error! Some data may be deprecated." << std::endl;
         }
+        if (syncEachStatement && bpm->commit() != 0)
+            std::cout << "Error! Failed to sync data to disk." << std::endl;
     }
 
+    bpm->stopFlusher();
+    int ret = 0;
+    int synced = bpm->checkpoint();
+    if (bpm->close() != 0 || synced != 0)
+    {
+        std::cout << "Error! Failed to sync data to disk." << std::endl;
+        ret = 1;
+    }
     delete qm;
     delete sm;
     delete im;
     delete rm;
-    return 0;
+    return ret;
 }
\ No newline at end of file
@@ -9,7 +9,6 @@
 #include <iomanip>
 #include <vector>
 #include <algorithm>
-#include <regex>
 
 class QueryManager
 {
@@ -85,10 +84,10 @@ public:
 
             if (conditions.size() == 0)
             {
-                fs.openScan(fh, AttrType::ANY, -1, -1, CompOp::NO, nullptr);
-                Record rec;
-                while (fs.getNextRec(rec))
-                    results.push_back(rec);
+                fs.openScan(fh, AttrType::ANY, -1, -1, CompOp::NO, nullptr, true);
+                RecordView view;
+                while (fs.getNextView(view))
+                    results.push_back(view.materialize());
                 fs.closeScan();
             }
             else
@@ -96,7 +95,7 @@ public:
                 if (optimizeConditions(conditions))
                 {
                     std::vector<CompareCondition> conds;
-                    for (auto cond : conditions)
+                    for (const auto &cond : conditions)
                     {
                         auto it = std::find(allAttrName.begin(), allAttrName.end(), cond.lhs.attrName);
                         if (it == allAttrName.end())
@@ -126,7 +125,7 @@ public:
                         {
                             cc.rhsAttr = false;
                             if (cond.op == CompOp::IN || cond.op >= 11)
-                                for (auto val : cond.rhsValues)
+                                for (const auto &val : cond.rhsValues)
                                     cc.vals.push_back(val.pData);
                             else
                                 cc.val = cond.rhsValue.pData;
@@ -151,23 +150,24 @@ public:
                         is.openScan(ih, used_op, used_keys);
                         RID rid;
                         Record rec;
+                        Predicate pred(otherConds);
                         while (is.getNextEntry(rid))
                         {
                             fh.getRec(rid, rec);
                             DataType tmp;
                             rec.getData(tmp);
-                            if (fs.compareMultiple(tmp, otherConds))
-                                results.push_back(rec);
+                            if (pred.test(tmp))
+                                results.push_back(std::move(rec));
                         }
                         is.closeScan();
                         im->closeIndex(sm->openedDbName + "/" + tableName, used_indexNo);
                     }
                     else
                     {
-                        fs.openScan(fh, conds);
-                        Record rec;
-                        while (fs.getNextRec(rec))
-                            results.push_back(rec);
+                        fs.openScan(fh, conds, true);
+                        RecordView view;
+                        while (fs.getNextView(view))
+                            results.push_back(view.materialize());
                         fs.closeScan();
                     }
                 }
@@ -177,7 +177,7 @@ public:
             if (final)
             {
                 printRecHeader(attrName);
-                for (auto rec : results)
+                for (const auto &rec : results)
                 {
                     DataType tmp;
                     rec.getData(tmp);
@@ -271,23 +271,21 @@ public:
 
             if (conditions.size() == 0)
             {
-                lfs.openScan(lfh, AttrType::ANY, -1, -1, CompOp::NO, nullptr);
-                Record rec;
-                Record lrec;
-                while (lfs.getNextRec(lrec))
+                lfs.openScan(lfh, AttrType::ANY, -1, -1, CompOp::NO, nullptr, true);
+                RecordView lview;
+                while (lfs.getNextView(lview))
                 {
                     DataType ldata;
-                    lrec.getData(ldata);
-                    rfs.openScan(rfh, AttrType::ANY, -1, -1, CompOp::NO, nullptr);
-                    Record rrec;
-                    while (rfs.getNextRec(rrec))
+                    lview.getData(ldata);
+                    rfs.openScan(rfh, AttrType::ANY, -1, -1, CompOp::NO, nullptr, true);
+                    RecordView rview;
+                    while (rfs.getNextView(rview))
                     {
                         DataType rdata;
-                        rrec.getData(rdata);
+                        rview.getData(rdata);
                         memcpy(joinedData, ldata, leftTupleLen);
                         memcpy(joinedData + leftTupleLen, rdata, rightTupleLen);
-                        rec.set(defaultRID, joinedData, leftTupleLen + rightTupleLen);
-                        results.push_back(rec);
+                        results.emplace_back(defaultRID, joinedData, leftTupleLen + rightTupleLen);
                     }
                     rfs.closeScan();
                 }
@@ -298,7 +296,7 @@ public:
                 if (optimizeConditions(conditions))
                 {
                     std::vector<CompareCondition> lconds, rconds, lrconds, rlconds;
-                    for (auto cond : conditions)
+                    for (const auto &cond : conditions)
                     {
                         if (cond.lhs.relName == relations[0])
                         {
@@ -372,7 +370,7 @@ public:
                                 cc.len = leftAllTypeLens[idx];
                                 cc.rhsAttr = false;
                                 if (cond.op == CompOp::IN || cond.op >= 11)
-                                    for (auto val : cond.rhsValues)
+                                    for (const auto &val : cond.rhsValues)
                                         cc.vals.push_back(val.pData);
                                 else
                                 {
@@ -454,7 +452,7 @@ public:
                                 cc.len = rightAllTypeLens[idx];
                                 cc.rhsAttr = false;
                                 if (cond.op == CompOp::IN || cond.op >= 11)
-                                    for (auto val : cond.rhsValues)
+                                    for (const auto &val : cond.rhsValues)
                                         cc.vals.push_back(val.pData);
                                 else
                                     cc.val = cond.rhsValue.pData;
@@ -484,7 +482,6 @@ public:
                     checkPrimaryKeyAndIndex(leftTableName, lconds, luse_indexNo, lused_indexNo, lused_op, lused_keys, lotherConds);
                     checkPrimaryKeyAndIndex(rightTableName, rconds, ruse_indexNo, rused_indexNo, rused_op, rused_keys, rotherConds);
 
-                    Record rec;
                     if (luse_indexNo)
                     {
                         IndexHandle lih;
@@ -494,16 +491,17 @@ public:
                         RID lrid;
                         Record lrec;
                         DataType ldata;
+                        Predicate lpred(lotherConds);
                         while (lis.getNextEntry(lrid))
                         {
                             lfh.getRec(lrid, lrec);
                             lrec.getData(ldata);
 
-                            if (!lfs.compareMultiple(ldata, lotherConds))
+                            if (!lpred.test(ldata))
                                 continue;
 
                             std::vector<CompareCondition> rconds_ext = rconds;
-                            for (auto rlc : rlconds)
+                            for (const auto &rlc : rlconds)
                             {
                                 CompareCondition rc = rlc;
                                 memcpy(&rc.val, ldata + rc.rhsOffset, rc.len);
@@ -513,7 +511,6 @@ public:
 
                             checkPrimaryKeyAndIndex(rightTableName, rconds_ext, ruse_indexNo, rused_indexNo, rused_op, rused_keys, rotherConds);
 
-                            Record rec;
                             if (ruse_indexNo)
                             {
                                 IndexHandle rih;
@@ -523,32 +520,31 @@ public:
                                 RID rrid;
                                 Record rrec;
                                 DataType rdata;
+                                Predicate rpred(rotherConds);
                                 while (ris.getNextEntry(rrid))
                                 {
                                     rfh.getRec(rrid, rrec);
                                     rrec.getData(rdata);
-                                    if (!rfs.compareMultiple(rdata, rotherConds))
+                                    if (!rpred.test(rdata))
                                         continue;
                                     memcpy(joinedData, ldata, leftTupleLen);
                                     memcpy(joinedData + leftTupleLen, rdata, rightTupleLen);
-                                    rec.set(defaultRID, joinedData, leftTupleLen + rightTupleLen);
-                                    results.push_back(rec);
+                                    results.emplace_back(defaultRID, joinedData, leftTupleLen + rightTupleLen);
                                 }
                                 ris.closeScan();
                                 im->closeIndex(sm->openedDbName + "/" + rightTableName, rused_indexNo);
                             }
                             else
                             {
-                                rfs.openScan(rfh, rconds_ext);
-                                Record rrec;
+                                rfs.openScan(rfh, rconds_ext, true);
+                                RecordView rview;
                                 DataType rdata;
-                                while (rfs.getNextRec(rrec))
+                                while (rfs.getNextView(rview))
                                 {
-                                    rrec.getData(rdata);
+                                    rview.getData(rdata);
                                     memcpy(joinedData, ldata, leftTupleLen);
                                     memcpy(joinedData + leftTupleLen, rdata, rightTupleLen);
-                                    rec.set(defaultRID, joinedData, leftTupleLen + rightTupleLen);
-                                    results.push_back(rec);
+                                    results.emplace_back(defaultRID, joinedData, leftTupleLen + rightTupleLen);
                                 }
                                 rfs.closeScan();
                             }
@@ -565,16 +561,17 @@ public:
                         RID rrid;
                         Record rrec;
                         DataType rdata;
+                        Predicate rpred(rotherConds);
                         while (ris.getNextEntry(rrid))
                         {
                             rfh.getRec(rrid, rrec);
                             rrec.getData(rdata);
 
-                            if (!rfs.compareMultiple(rdata, rotherConds))
+                            if (!rpred.test(rdata))
                                 continue;
 
                             std::vector<CompareCondition> lconds_ext = lconds;
-                            for (auto lrc : lrconds)
+                            for (const auto &lrc : lrconds)
                             {
                                 CompareCondition lc = lrc;
                                 memcpy(&lc.val, rdata + lc.rhsOffset, lc.len);
@@ -584,7 +581,6 @@ public:
 
                             checkPrimaryKeyAndIndex(leftTableName, lconds_ext, luse_indexNo, lused_indexNo, lused_op, lused_keys, lotherConds);
 
-                            Record rec;
                             if (luse_indexNo)
                             {
                                 IndexHandle lih;
@@ -594,32 +590,31 @@ public:
                                 RID lrid;
                                 Record lrec;
                                 DataType ldata;
+                                Predicate lpred(lotherConds);
                                 while (lis.getNextEntry(lrid))
                                 {
                                     lfh.getRec(lrid, lrec);
                                     lrec.getData(ldata);
-                                    if (!lfs.compareMultiple(ldata, lotherConds))
+                                    if (!lpred.test(ldata))
                                         continue;
                                     memcpy(joinedData, ldata, leftTupleLen);
                                     memcpy(joinedData + leftTupleLen, rdata, rightTupleLen);
-                                    rec.set(defaultRID, joinedData, leftTupleLen + rightTupleLen);
-                                    results.push_back(rec);
+                                    results.emplace_back(defaultRID, joinedData, leftTupleLen + rightTupleLen);
                                 }
                                 ris.closeScan();
                                 im->closeIndex(sm->openedDbName + "/" + leftTableName, lused_indexNo);
                             }
                             else
                             {
-                                lfs.openScan(lfh, lconds_ext);
-                                Record lrec;
+                                lfs.openScan(lfh, lconds_ext, true);
+                                RecordView lview;
                                 DataType ldata;
-                                while (lfs.getNextRec(lrec))
+                                while (lfs.getNextView(lview))
                                 {
-                                    lrec.getData(ldata);
+                                    lview.getData(ldata);
                                     memcpy(joinedData, ldata, leftTupleLen);
                                     memcpy(joinedData + leftTupleLen, rdata, rightTupleLen);
-                                    rec.set(defaultRID, joinedData, leftTupleLen + rightTupleLen);
-                                    results.push_back(rec);
+                                    results.emplace_back(defaultRID, joinedData, leftTupleLen + rightTupleLen);
                                 }
                                 rfs.closeScan();
                             }
@@ -629,16 +624,15 @@ public:
                     }
                     else
                     {
-                        lfs.openScan(lfh, lconds);
-                        Record rec;
-                        Record lrec;
+                        lfs.openScan(lfh, lconds, true);
+                        RecordView lview;
                         DataType ldata;
-                        while (lfs.getNextRec(lrec))
+                        while (lfs.getNextView(lview))
                         {
-                            lrec.getData(ldata);
+                            lview.getData(ldata);
 
                             std::vector<CompareCondition> rconds_ext = rconds;
-                            for (auto rlc : rlconds)
+                            for (const auto &rlc : rlconds)
                             {
                                 CompareCondition rc = rlc;
                                 memcpy(&rc.val, ldata + rc.rhsOffset, rc.len);
@@ -652,7 +646,6 @@ public:
                             std::vector<int> rused_keys;
                             checkPrimaryKeyAndIndex(rightTableName, rconds_ext, ruse_indexNo, rused_indexNo, rused_op, rused_keys, rotherConds);
 
-                            Record rec;
                             if (ruse_indexNo)
                             {
                                 IndexHandle rih;
@@ -662,32 +655,31 @@ public:
                                 RID rrid;
                                 Record rrec;
                                 DataType rdata;
+                                Predicate rpred(rotherConds);
                                 while (ris.getNextEntry(rrid))
                                 {
                                     rfh.getRec(rrid, rrec);
                                     rrec.getData(rdata);
-                                    if (!rfs.compareMultiple(rdata, rotherConds))
+                                    if (!rpred.test(rdata))
                                         continue;
                                     memcpy(joinedData, ldata, leftTupleLen);
                                     memcpy(joinedData + leftTupleLen, rdata, rightTupleLen);
-                                    rec.set(defaultRID, joinedData, leftTupleLen + rightTupleLen);
-                                    results.push_back(rec);
+                                    results.emplace_back(defaultRID, joinedData, leftTupleLen + rightTupleLen);
                                 }
                                 ris.closeScan();
                                 im->closeIndex(sm->openedDbName + "/" + rightTableName, rused_indexNo);
                             }
                             else
                             {
-                                rfs.openScan(rfh, rconds_ext);
-                                Record rrec;
+                                rfs.openScan(rfh, rconds_ext, true);
+                                RecordView rview;
                                 DataType rdata;
-                                while (rfs.getNextRec(rrec))
+                                while (rfs.getNextView(rview))
                                 {
-                                    rrec.getData(rdata);
+                                    rview.getData(rdata);
                                     memcpy(joinedData, ldata, leftTupleLen);
                                     memcpy(joinedData + leftTupleLen, rdata, rightTupleLen);
-                                    rec.set(defaultRID, joinedData, leftTupleLen + rightTupleLen);
-                                    results.push_back(rec);
+                                    results.emplace_back(defaultRID, joinedData, leftTupleLen + rightTupleLen);
                                 }
                                 rfs.closeScan();
                             }
@@ -701,7 +693,7 @@ public:
             if (final)
             {
                 printRecHeader(attrName);
-                for (auto rec : results)
+                for (const auto &rec : results)
                 {
                     DataType tmp;
                     rec.getData(tmp);
@@ -854,12 +846,12 @@ public:
         {
             rm->openFile(sm->openedDbName + "/" + tableName, fh);
             DataType data;
-            Record rec;
+            RecordView view;
             fs.openScan(fh, AttrType::ANY, 4, 0, CompOp::NO, nullptr);
-            while (fs.getNextRec(rec))
+            while (fs.getNextView(view))
             {
                 flag = true;
-                rec.getData(data);
+                view.getData(data);
                 for (auto i = 0; i < uniq.size() && flag; i++)
                 {
                     auto it = std::find(offsets.begin(), offsets.end(), uniq[i]);
@@ -974,7 +966,7 @@ public:
 
         // translate conditions
         std::vector<CompareCondition> conds;
-        for (auto cond : conditions)
+        for (const auto &cond : conditions)
         {
             auto it = std::find(allAttrName.begin(), allAttrName.end(), cond.lhs.attrName);
             if (it == allAttrName.end())
@@ -989,7 +981,7 @@ public:
             cc.type = allTypes[idx];
             cc.len = allTypeLens[idx];
             if (cond.op == CompOp::IN || cond.op >= 11)
-                for (auto val : cond.rhsValues)
+                for (const auto &val : cond.rhsValues)
                     cc.vals.push_back(val.pData);
             else
             {
@@ -1039,12 +1031,13 @@ public:
             im->openIndex(sm->openedDbName + "/" + tableName, used_indexNo, ih);
             is.openScan(ih, used_op, used_keys);
             RID rid;
+            Predicate pred(otherConds);
             while (is.getNextEntry(rid))
             {
                 fh.getRec(rid, rec);
                 DataType tmp;
                 rec.getData(tmp);
-                if (!fs.compareMultiple(tmp, otherConds))
+                if (!pred.test(tmp))
                     continue;
                 results.push_back(rid);
             }
@@ -1054,10 +1047,11 @@ public:
         else
         {
             fs.openScan(fh, conds);
-            while (fs.getNextRec(rec))
+            RecordView view;
+            while (fs.getNextView(view))
             {
                 RID rid;
-                rec.getRID(rid);
+                view.getRID(rid);
                 results.push_back(rid);
             }
             fs.closeScan();
@@ -1285,7 +1279,7 @@ public:
         FileScan fs;
 
         std::vector<CompareCondition> conds;
-        for (auto cond : conditions)
+        for (const auto &cond : conditions)
         {
             auto it = std::find(allAttrName.begin(), allAttrName.end(), cond.lhs.attrName);
             if (it == allAttrName.end())
@@ -1300,7 +1294,7 @@ public:
             cc.type = allTypes[idx];
             cc.len = allTypeLens[idx];
             if (cond.op == CompOp::IN || cond.op >= 11)
-                for (auto val : cond.rhsValues)
+                for (const auto &val : cond.rhsValues)
                     cc.vals.push_back(val.pData);
             else
             {
@@ -1350,12 +1344,13 @@ public:
             im->openIndex(sm->openedDbName + "/" + tableName, used_indexNo, ih);
             is.openScan(ih, used_op, used_keys);
             RID rid;
+            Predicate pred(otherConds);
             while (is.getNextEntry(rid))
             {
                 fh.getRec(rid, rec);
                 DataType tmp;
                 rec.getData(tmp);
-                if (!fs.compareMultiple(tmp, otherConds))
+                if (!pred.test(tmp))
                     continue;
                 results.push_back(rid);
             }
@@ -1365,10 +1360,11 @@ public:
         else
         {
             fs.openScan(fh, conds);
-            while (fs.getNextRec(rec))
+            RecordView view;
+            while (fs.getNextView(view))
             {
                 RID rid;
-                rec.getRID(rid);
+                view.getRID(rid);
                 results.push_back(rid);
             }
             fs.closeScan();
@@ -1388,12 +1384,12 @@ public:
             for (auto uniq : uniqueNo)
             {
                 DataType data;
-                Record rec;
+                RecordView view;
                 fs.openScan(fh, AttrType::ANY, 4, 0, CompOp::NO, nullptr);
-                while (fs.getNextRec(rec))
+                while (fs.getNextView(view))
                 {
                     flag = true;
-                    rec.getData(data);
+                    view.getData(data);
                     for (auto i = 0; i < uniq.size() && flag; i++)
                     {
                         auto it = std::find(allOffsets.begin(), allOffsets.end(), uniq[i]);
@@ -1683,7 +1679,7 @@ public:
                 std::vector<CompareCondition> sortedConds(index.size());
                 std::vector<bool> sortedCondsOccupied(index.size(), false);
                 std::vector<CompareCondition> tmp_other;
-                for (auto cond : conds)
+                for (const auto &cond : conds)
                 {
                     auto it = std::find(index.begin(), index.end(), cond.offset);
                     auto idx = std::distance(index.begin(), it);
@@ -1931,7 +1927,7 @@ public:
                             t.rhsValue = s.rhsValue;
                             break;
                         case CompOp::LIKE:
-                            if (!std::regex_match(s.rhsValue.pData.String, std::regex(t.rhsValue.pData.String)))
+                            if (!LikeMatcher(t.rhsValue.pData.String).match(s.rhsValue.pData.String))
                                 return false;
                             t.op = CompOp::E;
                             t.rhsValue = s.rhsValue;
@@ -2549,14 +2545,17 @@ public:
                         case CompOp::ISNOTNULL:
                             break;
                         case CompOp::LIKE:
+                        {
                             t.rhsValues.clear();
-                            for (auto v : s.rhsValues)
-                                if (std::regex_match(v.pData.String, std::regex(t.rhsValue.pData.String)))
+                            LikeMatcher like(t.rhsValue.pData.String);
+                            for (const auto &v : s.rhsValues)
+                                if (like.match(v.pData.String))
                                     t.rhsValues.push_back(v);
                             if (t.rhsValues.size() == 0)
                                 return false;
                             t.op = CompOp::IN;
                             break;
+                        }
                         case CompOp::BETWEEN:
                         {
                             std::vector<Value> tmp;
@@ -2660,18 +2659,21 @@ public:
                         switch (t.op)
                         {
                         case CompOp::E:
-                            if (!std::regex_match(t.rhsValue.pData.String, std::regex(s.rhsValue.pData.String)))
+                            if (!LikeMatcher(s.rhsValue.pData.String).match(t.rhsValue.pData.String))
                                 return false;
                             break;
                         case CompOp::IN:
+                        {
                             s.rhsValues.clear();
-                            for (auto v : t.rhsValues)
-                                if (std::regex_match(v.pData.String, std::regex(s.rhsValue.pData.String)))
+                            LikeMatcher like(s.rhsValue.pData.String);
+                            for (const auto &v : t.rhsValues)
+                                if (like.match(v.pData.String))
                                     s.rhsValues.push_back(v);
                             if (s.rhsValues.size() == 0)
                                 return false;
                             t.rhsValues = s.rhsValues;
                             break;
+                        }
                         default:
                             newConditions.push_back(conditions[i]);
                             break;
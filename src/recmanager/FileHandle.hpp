@@ -4,14 +4,18 @@
 #include "constants.h"
 #include "RID.hpp"
 #include "Record.hpp"
-#include "../bufmanager/BufPageManager.h"
+#include "SlottedPage.hpp"
+#include "../bufmanager/PageGuard.h"
 
 class FileHandle
 {
 private:
     int fileID;
     BufPageManager *bpm;
+    // Copy of the header in page 0: pages are latched while they are read or written, but
+    // only one handle at a time may insert into or delete from a table.
     FileHeader fh;
+    bool slotted;
 
 public:
     FileHandle() {}
@@ -19,11 +23,14 @@ public:
     {
         fileID = _fileID;
         bpm = _bpm;
-        int index;
-        BufType b = bpm->getPage(fileID, 0, index);
-        DataType d = reinterpret_cast<DataType>(b);
+        PageGuard header(bpm, fileID, 0, LATCH_SHARED);
+        DataType d = reinterpret_cast<DataType>(header.data());
         memcpy(&fh, d, sizeof(fh));
-        bpm->access(index);
+        slotted = slottedFile(d);
+        bool mapped = FreeSpaceMap(d).valid();
+        header.release();
+        if (!mapped)
+            buildFreeSpaceMap();
     }
     ~FileHandle()
     {
@@ -44,54 +51,61 @@ public:
         _bpm = bpm;
         return true;
     }
+    bool isSlotted() const
+    {
+        return slotted;
+    }
     bool getRec(const RID &rid, Record &rec) const
     {
-        int index, pageID, slotID;
+        if (slotted)
+            return getSlottedRec(rid, rec);
+        int pageID, slotID;
         rid.getPageID(pageID);
         rid.getSlotID(slotID);
-        BufType b = bpm->getPage(fileID, pageID, index);
-        DataType d = reinterpret_cast<DataType>(b);
+        PageGuard page(bpm, fileID, pageID, LATCH_SHARED);
+        DataType d = reinterpret_cast<DataType>(page.data());
         rec.set(rid, &d[fh.slotMapSize + fh.slotSize * slotID], fh.slotSize);
-        bpm->access(index);
         return true;
     }
     bool insertRec(const DataType pData, RID &rid)
     {
-        int index, pageID, slotID;
+        if (slotted)
+        {
+            char buf[PAGE_SIZE];
+            return insertTuple(buf, encodeRecord(pData, fh.slotSize, buf), 0, rid);
+        }
+        int pageID, slotID;
         getNextFreeSlot(rid);
         rid.getPageID(pageID);
         rid.getSlotID(slotID);
-        BufType b = bpm->getPage(fileID, pageID, index);
-        DataType d = reinterpret_cast<DataType>(b);
+        PageGuard page(bpm, fileID, pageID, LATCH_EXCLUSIVE);
+        DataType d = reinterpret_cast<DataType>(page.data());
         memcpy(&d[fh.slotMapSize + fh.slotSize * slotID], pData, fh.slotSize);
         SlotMap slotMap(d, fh.capacity);
         slotMap.set(slotID);
-        bpm->markDirty(index);
+        page.markDirty();
         // bpm->writeBack(index);
+        bool full = slotMap.findFree(slotID + 1) == -1;
+        page.release();
+        if (full)
+            setPageFree(pageID, false);
         return true;
     }
     bool deleteRec(const RID &rid)
     {
-        int index, pageID, slotID;
+        int pageID, slotID;
         rid.getPageID(pageID);
         rid.getSlotID(slotID);
+        if (slotted)
+            return deleteTuple(pageID, slotID);
 
-        if (fh.firstFree > pageID)
-        {
-            fh.firstFree = pageID;
-            BufType b = bpm->getPage(fileID, 0, index);
-            DataType d = reinterpret_cast<DataType>(b);
-            memcpy(d, &fh, sizeof(fh));
-            bpm->markDirty(index);
-            bpm->writeBack(index);
-        }
-
-        BufType b = bpm->getPage(fileID, pageID, index);
-        DataType d = reinterpret_cast<DataType>(b);
-        SlotMap slotMap(d, fh.capacity);
+        PageGuard page(bpm, fileID, pageID, LATCH_EXCLUSIVE);
+        SlotMap slotMap(reinterpret_cast<DataType>(page.data()), fh.capacity);
         slotMap.remove(slotID);
-        bpm->markDirty(index);
+        page.markDirty();
         // bpm->writeBack(index);
+        page.release();
+        setPageFree(pageID, true);
         return true;
     }
     bool updateRec(const Record &rec)
@@ -100,34 +114,38 @@ public:
         rec.getRID(rid);
         DataType pData;
         rec.getData(pData);
-        int index, pageID, slotID;
+        int pageID, slotID;
         rid.getPageID(pageID);
         rid.getSlotID(slotID);
-        BufType b = bpm->getPage(fileID, pageID, index);
-        DataType d = reinterpret_cast<DataType>(b);
+        if (slotted)
+            return updateTuple(pageID, slotID, pData);
+        PageGuard page(bpm, fileID, pageID, LATCH_EXCLUSIVE);
+        DataType d = reinterpret_cast<DataType>(page.data());
         memcpy(&d[fh.slotMapSize + fh.slotSize * slotID], pData, fh.slotSize);
-        SlotMap slotMap(d, fh.capacity);
-        bpm->markDirty(index);
+        page.markDirty();
+        return true;
+    }
+    bool forcePage(const int pageId)
+    {
         return true;
     }
-    bool forcePage(const int pageId) {}
     bool getNextFreeSlot(RID &rid)
     {
-        int pageID = fh.firstFree;
-        if (fh.firstFree >= fh.numPages)
-            getNewPage(pageID);
-        int index;
-        BufType b = bpm->getPage(fileID, pageID, index);
-        DataType d = reinterpret_cast<DataType>(b);
-        SlotMap slotMap(d, fh.capacity);
-        for (int i = 0; i < fh.capacity; i++)
+        int pageID = nextFreePage(1);
+        while (pageID < fh.numPages)
         {
-            if (!slotMap.test(i))
+            PageGuard page(bpm, fileID, pageID, LATCH_SHARED);
+            SlotMap slotMap(reinterpret_cast<DataType>(page.data()), fh.capacity);
+            int slotID = slotMap.findFree();
+            page.release();
+            if (slotID != -1)
             {
                 rid.setPageID(pageID);
-                rid.setSlotID(i);
+                rid.setSlotID(slotID);
                 return true;
             }
+            setPageFree(pageID, false);
+            pageID = (pageID < FSM_PAGES) ? nextFreePage(pageID + 1) : pageID + 1;
         }
         getNewPage(pageID);
         rid.setPageID(pageID);
@@ -137,21 +155,238 @@ public:
     bool getNewPage(int &pageID)
     {
         pageID = fh.numPages;
-        int index;
-        bpm->allocPage(fileID, pageID, index, false);
+        PageGuard page(bpm, fileID, pageID, LATCH_EXCLUSIVE);
+        memset(page.data(), 0, fh.slotMapSize);
+        if (slotted)
+            SlottedPage(reinterpret_cast<DataType>(page.data())).init();
+        page.markDirty();
+        page.release();
         fh.numPages++;
         fh.firstFree = pageID;
-        BufType b = bpm->getPage(fileID, 0, index);
-        DataType d = reinterpret_cast<DataType>(b);
-        memcpy(d, &fh, sizeof(fh));
-        bpm->markDirty(index);
-        bpm->writeBack(index);
-
-        b = bpm->getPage(fileID, pageID, index);
-        d = reinterpret_cast<DataType>(b);
-        memset(d, 0, fh.slotMapSize);
-        bpm->markDirty(index);
-        bpm->writeBack(index);
+        saveHeader();
+        setPageFree(pageID, true);
+        return true;
+    }
+    // Copies the in-memory header into the cached page 0; it reaches disk with the next
+    // flush, commit or close like any other dirty page.
+    bool saveHeader()
+    {
+        PageGuard header(bpm, fileID, 0, LATCH_EXCLUSIVE);
+        memcpy(header.data(), &fh, sizeof(fh));
+        header.markDirty();
+        return true;
+    }
+    // First page at or after `from` that may have a free slot, or numPages if there is none.
+    // Pages past the map are only reached through fh.firstFree.
+    int nextFreePage(int from)
+    {
+        if (from < FSM_PAGES)
+        {
+            PageGuard header(bpm, fileID, 0, LATCH_SHARED);
+            FreeSpaceMap fsm(reinterpret_cast<DataType>(header.data()));
+            int pageID = fsm.find(from);
+            if (pageID != -1 && pageID < fh.numPages)
+                return pageID;
+        }
+        if (fh.numPages > FSM_PAGES)
+            return std::max(std::max(fh.firstFree, from), (int)FSM_PAGES);
+        return fh.numPages;
+    }
+    // Records in the free-space map whether a data page still has a free slot.
+    // Pages past the map move fh.firstFree instead, and the header is saved when it changes.
+    void setPageFree(int pageID, bool free)
+    {
+        if (pageID >= FSM_PAGES)
+        {
+            int firstFree = fh.firstFree;
+            if (free && fh.firstFree > pageID)
+                fh.firstFree = pageID;
+            else if (!free && fh.firstFree == pageID)
+                fh.firstFree = pageID + 1;
+            if (fh.firstFree != firstFree)
+                saveHeader();
+            return;
+        }
+        PageGuard header(bpm, fileID, 0, LATCH_EXCLUSIVE);
+        FreeSpaceMap fsm(reinterpret_cast<DataType>(header.data()));
+        if (fsm.test(pageID) == free)
+            return;
+        if (free)
+            fsm.set(pageID);
+        else
+            fsm.remove(pageID);
+        header.markDirty();
+    }
+    // Fills the map for a file written before it had one.
+    void buildFreeSpaceMap()
+    {
+        std::vector<int> freePages;
+        for (int pageID = 1; pageID < fh.numPages && pageID < FSM_PAGES; pageID++)
+        {
+            PageGuard page(bpm, fileID, pageID, LATCH_SHARED);
+            if (hasRoom(reinterpret_cast<DataType>(page.data())))
+                freePages.push_back(pageID);
+        }
+        PageGuard header(bpm, fileID, 0, LATCH_EXCLUSIVE);
+        FreeSpaceMap fsm(reinterpret_cast<DataType>(header.data()));
+        fsm.init();
+        for (int pageID : freePages)
+            fsm.set(pageID);
+        header.markDirty();
+    }
+    // A page is free if it still has a free slot, or for slotted files room for the largest tuple.
+    bool hasRoom(const DataType d) const
+    {
+        if (slotted)
+            return SlottedPage(d).fits(maxEncodedSize(fh.slotSize));
+        return SlotMap(d, fh.capacity).findFree() != -1;
+    }
+    bool getSlottedRec(const RID &rid, Record &rec) const
+    {
+        char data[PAGE_SIZE];
+        if (!readTuple(rid, data))
+            return false;
+        rec.set(rid, data, fh.slotSize);
+        return true;
+    }
+    // Decodes the slotted record at rid, following a forwarding stub, into slotSize bytes at data.
+    bool readTuple(const RID &rid, DataType data) const
+    {
+        int pageID, slotID;
+        rid.getPageID(pageID);
+        rid.getSlotID(slotID);
+        PageGuard page(bpm, fileID, pageID, LATCH_SHARED);
+        SlottedPage sp(reinterpret_cast<DataType>(page.data()));
+        if (!sp.used(slotID))
+            return false;
+        if (sp.flags(slotID) & SLOT_FORWARD)
+        {
+            memcpy(&pageID, sp.tuple(slotID), sizeof(int));
+            memcpy(&slotID, sp.tuple(slotID) + sizeof(int), sizeof(int));
+            page.release();
+            page = PageGuard(bpm, fileID, pageID, LATCH_SHARED);
+            sp = SlottedPage(reinterpret_cast<DataType>(page.data()));
+        }
+        decodeRecord(sp.tuple(slotID), data, fh.slotSize);
+        return true;
+    }
+    // Stores an encoded tuple on the first page with room for the largest one.
+    bool insertTuple(const char *data, int n, int flag, RID &rid)
+    {
+        int pageID = nextFreePage(1);
+        while (true)
+        {
+            if (pageID >= fh.numPages)
+                getNewPage(pageID);
+            PageGuard page(bpm, fileID, pageID, LATCH_EXCLUSIVE);
+            SlottedPage sp(reinterpret_cast<DataType>(page.data()));
+            int slotID = sp.insert(data, n, flag);
+            if (slotID != -1)
+            {
+                page.markDirty();
+                bool room = hasRoom(sp.page);
+                page.release();
+                if (!room)
+                    setPageFree(pageID, false);
+                rid.setPageID(pageID);
+                rid.setSlotID(slotID);
+                return true;
+            }
+            page.release();
+            setPageFree(pageID, false);
+            pageID = (pageID < FSM_PAGES) ? nextFreePage(pageID + 1) : pageID + 1;
+        }
+    }
+    bool deleteTuple(int pageID, int slotID)
+    {
+        PageGuard page(bpm, fileID, pageID, LATCH_EXCLUSIVE);
+        SlottedPage sp(reinterpret_cast<DataType>(page.data()));
+        if (!sp.used(slotID))
+            return false;
+        if (sp.flags(slotID) & SLOT_FORWARD)
+        {
+            int target[2];
+            memcpy(target, sp.tuple(slotID), sizeof(target));
+            sp.remove(slotID);
+            page.markDirty();
+            bool room = hasRoom(sp.page);
+            page.release();
+            if (room)
+                releaseTuple(pageID);
+            pageID = target[0];
+            slotID = target[1];
+            page = PageGuard(bpm, fileID, pageID, LATCH_EXCLUSIVE);
+            sp = SlottedPage(reinterpret_cast<DataType>(page.data()));
+        }
+        sp.remove(slotID);
+        page.markDirty();
+        bool room = hasRoom(sp.page);
+        page.release();
+        if (room)
+            releaseTuple(pageID);
+        return true;
+    }
+    // Updates the free-space map after space was given back on a page that now has room.
+    // The page itself must not be latched by the caller.
+    void releaseTuple(int pageID)
+    {
+        setPageFree(pageID, true);
+    }
+    // Rewrites a tuple in place when its page has room, otherwise moves it to another page
+    // and leaves a forwarding stub behind so the RID stays valid.
+    bool updateTuple(int pageID, int slotID, const DataType pData)
+    {
+        char buf[PAGE_SIZE];
+        int n = encodeRecord(pData, fh.slotSize, buf);
+        PageGuard page(bpm, fileID, pageID, LATCH_EXCLUSIVE);
+        SlottedPage sp(reinterpret_cast<DataType>(page.data()));
+        if (!sp.used(slotID))
+            return false;
+        int homePage = pageID, homeSlot = slotID, flag = 0;
+        if (sp.flags(slotID) & SLOT_FORWARD)
+        {
+            memcpy(&pageID, sp.tuple(slotID), sizeof(int));
+            memcpy(&slotID, sp.tuple(slotID) + sizeof(int), sizeof(int));
+            page.release();
+            page = PageGuard(bpm, fileID, pageID, LATCH_EXCLUSIVE);
+            sp = SlottedPage(reinterpret_cast<DataType>(page.data()));
+            flag = SLOT_MOVED;
+        }
+        if (sp.replace(slotID, buf, n, flag))
+        {
+            page.markDirty();
+            bool room = hasRoom(sp.page);
+            page.release();
+            if (room)
+                releaseTuple(pageID);
+            else
+                setPageFree(pageID, false);
+            return true;
+        }
+        if (flag == SLOT_MOVED)
+        {
+            // drop the old moved copy; the stub is repointed below
+            sp.remove(slotID);
+            page.markDirty();
+            bool room = hasRoom(sp.page);
+            page.release();
+            if (room)
+                releaseTuple(pageID);
+        }
+        page.release();
+        RID moved;
+        insertTuple(buf, n, SLOT_MOVED, moved);
+        int target[2];
+        moved.getPageID(target[0]);
+        moved.getSlotID(target[1]);
+        page = PageGuard(bpm, fileID, homePage, LATCH_EXCLUSIVE);
+        sp = SlottedPage(reinterpret_cast<DataType>(page.data()));
+        sp.replace(homeSlot, reinterpret_cast<char *>(target), sizeof(target), SLOT_FORWARD);
+        page.markDirty();
+        bool room = hasRoom(sp.page);
+        page.release();
+        if (room)
+            releaseTuple(homePage);
         return true;
     }
-};
\ No newline at end of file
+};
@@ -2,9 +2,10 @@
 
 #include "constants.h"
 #include "FileHandle.hpp"
+#include "Predicate.hpp"
+#include "../bufmanager/PageGuard.h"
 
 #include <vector>
-#include <regex>
 
 class FileScan
 {
@@ -13,15 +14,18 @@ private:
     int fileID;
     FileHeader fh;
     BufPageManager *bpm;
-    AttrType type;
-    int len;
-    int offset;
-    CompOp op;
-    void *val;
+    Predicate predicate;
     int pageID, slotID;
+    ReadAhead ra;
+    BufType mapBase;
+    int mapPages, mapFileID;
+    PageGuard guard;
+    int guardPage;
     DataType curPage;
-    std::vector<CompareCondition> conditions;
-    bool multiCondition;
+    std::vector<char> row;
+    bool batch;
+    std::vector<unsigned long long> sel;
+    int selPage;
 
 public:
     FileScan()
@@ -29,319 +33,219 @@ public:
         pageID = 1;
         slotID = 0;
         curPage = nullptr;
+        mapBase = nullptr;
+        mapPages = 0;
+        mapFileID = -1;
+        guardPage = -1;
+        batch = false;
+        selPage = -1;
     }
-    ~FileScan() {}
-    bool openScan(const FileHandle &fileHandle, AttrType type, int len, int offset, CompOp op, void *val)
+    ~FileScan()
+    {
+        unmap();
+    }
+    bool openScan(const FileHandle &fileHandle, AttrType type, int len, int offset, CompOp op, void *val, bool readOnly = false)
     {
         handle = fileHandle;
         fileHandle.getFileID(fileID);
         fileHandle.getFileHeader(fh);
         fileHandle.getBufPageManager(bpm);
-        this->type = type;
-        this->len = len;
-        this->offset = offset;
-        this->op = op;
-        this->val = val;
+        predicate.compile(op, type, offset, val);
         pageID = 1;
         slotID = 0;
         curPage = nullptr;
-        multiCondition = false;
+        startPages(readOnly);
+        return true;
     }
-    bool openScan(const FileHandle &fileHandle, std::vector<CompareCondition> conditions)
+    bool openScan(const FileHandle &fileHandle, const std::vector<CompareCondition> &conditions, bool readOnly = false)
     {
         handle = fileHandle;
         fileHandle.getFileID(fileID);
         fileHandle.getFileHeader(fh);
         fileHandle.getBufPageManager(bpm);
-        this->conditions = conditions;
+        predicate.compile(conditions);
         pageID = 1;
         slotID = 0;
         curPage = nullptr;
-        multiCondition = true;
+        startPages(readOnly);
+        return true;
     }
+    // The page is latched shared only while it is searched and the record copied, so the
+    // caller may update or delete the returned record through its FileHandle.
     bool getNextRec(Record &rec)
     {
-        int index;
+        RecordView view;
+        guard.latch(LATCH_SHARED);
+        bool found = nextView(view);
+        if (found)
+        {
+            DataType data;
+            RID rid;
+            view.getData(data);
+            view.getRID(rid);
+            rec.set(rid, data, fh.slotSize);
+        }
+        guard.unlatch();
+        return found;
+    }
+    // Like getNextRec but without copying: the view points into the pinned page (or the
+    // decode buffer of a slotted file) and is valid until the next call or closeScan.
+    // The page is not latched once the call returns, so while another thread writes the
+    // table use getNextRec instead.
+    bool getNextView(RecordView &view)
+    {
+        guard.latch(LATCH_SHARED);
+        bool found = nextView(view);
+        guard.unlatch();
+        return found;
+    }
+    bool nextView(RecordView &view)
+    {
         for (; pageID < fh.numPages; pageID++)
         {
-            curPage = reinterpret_cast<DataType>(bpm->getPage(fileID, pageID, index));
+            if (mapBase)
+                curPage = reinterpret_cast<DataType>(mapBase) + ((size_t)pageID << PAGE_SIZE_IDX);
+            else if (guardPage != pageID)
+            {
+                // keep the current page pinned so later calls can read it in place
+                bpm->readAhead(ra, pageID);
+                guard.release();
+                guard = PageGuard(bpm, fileID, pageID, LATCH_SHARED, true);
+                guardPage = pageID;
+                curPage = reinterpret_cast<DataType>(guard.data());
+            }
+            if (handle.isSlotted())
+            {
+                if (nextSlotted(view))
+                    return true;
+                slotID = 0;
+                continue;
+            }
+            if (batch)
+            {
+                if (nextSelected(view))
+                    return true;
+                slotID = 0;
+                continue;
+            }
             SlotMap slotMap(curPage, fh.capacity);
             for (; slotID < fh.capacity; slotID++)
             {
                 if (slotMap.test(slotID) && compare(&curPage[fh.slotMapSize + fh.slotSize * slotID]))
                 {
-                    handle.getRec(RID(pageID, slotID), rec);
+                    view.set(RID(pageID, slotID), &curPage[fh.slotMapSize + fh.slotSize * slotID], fh.slotSize);
                     slotID++;
                     return true;
                 }
             }
             slotID = 0;
         }
+        unpin();
         return false;
     }
-    bool closeScan() {}
-    bool compare(DataType src)
-    {
-        if (multiCondition)
-            return compareMultiple(src, conditions);
-        else
-            return compareSingle(src, op, type, offset, len, val);
-    }
-    bool compareSingle(DataType src, CompOp op, AttrType type, int offset, int len, void *val, int attrIdx = -1)
+    // Read-only scans test a whole page of slots at once, then walk the rows that passed.
+    bool nextSelected(RecordView &view)
     {
-        SlotMap nullMap(src, fh.slotSize);
-        if (op == CompOp::NO)
-            return true;
-        if (op == CompOp::ISNULL)
-            return nullMap.test(offset);
-        if (op == CompOp::ISNOTNULL)
-            return !nullMap.test(offset);
-        if (multiCondition && nullMap.test(attrIdx))
-            return false;
-        switch (type)
+        if (selPage != pageID)
         {
-        case AttrType::INT:
-        {
-            int *lhs = reinterpret_cast<int *>(src + offset);
-            int *rhs = reinterpret_cast<int *>(val);
-            switch (op)
-            {
-            case CompOp::E:
-                return *lhs == *rhs;
-                break;
-            case CompOp::L:
-                return *lhs < *rhs;
-                break;
-            case CompOp::LE:
-                return *lhs <= *rhs;
-                break;
-            case CompOp::G:
-                return *lhs > *rhs;
-                break;
-            case CompOp::GE:
-                return *lhs >= *rhs;
-                break;
-            case CompOp::NE:
-                return *lhs != *rhs;
-                break;
-
-            default:
-                return false;
-                break;
-            }
+            selectPage();
+            selPage = pageID;
         }
-        case AttrType::FLOAT:
+        for (int w = slotID >> 6; w < (int)sel.size(); w++)
         {
-            float *lhs = reinterpret_cast<float *>(src + offset);
-            float *rhs = reinterpret_cast<float *>(val);
-            switch (op)
+            unsigned long long m = sel[w];
+            if ((w << 6) < slotID)
+                m &= ~0ULL << (slotID & 63);
+            if (m != 0)
             {
-            case CompOp::E:
-                return *lhs == *rhs;
-                break;
-            case CompOp::L:
-                return *lhs < *rhs;
-                break;
-            case CompOp::LE:
-                return *lhs <= *rhs;
-                break;
-            case CompOp::G:
-                return *lhs > *rhs;
-                break;
-            case CompOp::GE:
-                return *lhs >= *rhs;
-                break;
-            case CompOp::NE:
-                return *lhs != *rhs;
-                break;
-
-            default:
-                return false;
-                break;
+                slotID = (w << 6) + __builtin_ctzll(m);
+                view.set(RID(pageID, slotID), &curPage[fh.slotMapSize + fh.slotSize * slotID], fh.slotSize);
+                slotID++;
+                return true;
             }
         }
-        case AttrType::VARCHAR:
-        {
-            char *lhs = src + offset;
-            char *rhs = reinterpret_cast<char *>(val);
-            switch (op)
-            {
-            case CompOp::E:
-                return strcmp(lhs, rhs) == 0;
-                break;
-            case CompOp::L:
-                return strcmp(lhs, rhs) < 0;
-                break;
-            case CompOp::LE:
-                return strcmp(lhs, rhs) <= 0;
-                break;
-            case CompOp::G:
-                return strcmp(lhs, rhs) > 0;
-                break;
-            case CompOp::GE:
-                return strcmp(lhs, rhs) >= 0;
-                break;
-            case CompOp::NE:
-                return strcmp(lhs, rhs) != 0;
-                break;
-            case CompOp::LIKE:
-                return std::regex_match(lhs, std::regex(rhs));
-                break;
-            default:
-                return false;
-                break;
-            }
-        }
-        default:
-            return false;
-            break;
-        }
+        return false;
     }
-    bool compareSingle(DataType src, CompOp op, AttrType type, int offset, int len, int rhsOffset)
+    // Starts from the occupied slots in the SlotMap and keeps those that match every condition.
+    void selectPage()
     {
-        switch (type)
-        {
-        case AttrType::INT:
+        sel.assign((fh.capacity + 63) >> 6, 0);
+        memcpy(sel.data(), curPage, (fh.capacity + 7) >> 3);
+        if (fh.capacity & 63)
+            sel.back() &= (1ULL << (fh.capacity & 63)) - 1;
+        predicate.filter(&curPage[fh.slotMapSize], fh.slotSize, fh.capacity, sel.data());
+    }
+    // Decodes the tuples of the current slotted page; moved tuples are reached through their stubs.
+    bool nextSlotted(RecordView &view)
+    {
+        SlottedPage sp(curPage);
+        for (; slotID < sp.count(); slotID++)
         {
-            int *lhs = reinterpret_cast<int *>(src + offset);
-            int *rhs = reinterpret_cast<int *>(src + rhsOffset);
-            switch (op)
+            if (!sp.used(slotID) || (sp.flags(slotID) & SLOT_MOVED))
+                continue;
+            RID rid(pageID, slotID);
+            if (sp.flags(slotID) & SLOT_FORWARD)
             {
-            case CompOp::E:
-                return *lhs == *rhs;
-                break;
-            case CompOp::L:
-                return *lhs < *rhs;
-                break;
-            case CompOp::LE:
-                return *lhs <= *rhs;
-                break;
-            case CompOp::G:
-                return *lhs > *rhs;
-                break;
-            case CompOp::GE:
-                return *lhs >= *rhs;
-                break;
-            case CompOp::NE:
-                return *lhs != *rhs;
-                break;
-
-            default:
-                return false;
-                break;
+                int target[2];
+                memcpy(target, sp.tuple(slotID), sizeof(target));
+                handle.readTuple(RID(target[0], target[1]), row.data());
             }
-        }
-        case AttrType::FLOAT:
-        {
-            float *lhs = reinterpret_cast<float *>(src + offset);
-            float *rhs = reinterpret_cast<float *>(src + rhsOffset);
-            switch (op)
+            else
+                decodeRecord(sp.tuple(slotID), row.data(), fh.slotSize);
+            if (compare(row.data()))
             {
-            case CompOp::E:
-                return *lhs == *rhs;
-                break;
-            case CompOp::L:
-                return *lhs < *rhs;
-                break;
-            case CompOp::LE:
-                return *lhs <= *rhs;
-                break;
-            case CompOp::G:
-                return *lhs > *rhs;
-                break;
-            case CompOp::GE:
-                return *lhs >= *rhs;
-                break;
-            case CompOp::NE:
-                return *lhs != *rhs;
-                break;
-
-            default:
-                return false;
-                break;
+                view.set(rid, row.data(), fh.slotSize);
+                slotID++;
+                return true;
             }
         }
-        case AttrType::VARCHAR:
+        return false;
+    }
+    // The mapping is kept until the scan is destroyed or reopened on another file, so the
+    // inner scan of a nested-loop join maps its table once rather than once per outer row.
+    bool closeScan()
+    {
+        unpin();
+        return true;
+    }
+    // Read-only scans over large tables read pages straight from a shared
+    // mapping of the file; everything else goes through the buffer pool.
+    // A read-only reopen on the same file reuses the mapping, so the table
+    // must not be written in between.
+    void startPages(bool readOnly)
+    {
+        row.resize(fh.slotSize);
+        batch = readOnly && !handle.isSlotted();
+        selPage = -1;
+        unpin();
+        bool mapped = readOnly && fh.numPages >= MMAP_SCAN_MIN_PAGES;
+        if (mapBase && (!mapped || mapFileID != fileID || mapPages != fh.numPages))
+            unmap();
+        if (mapped && !mapBase)
         {
-            char *lhs = src + offset;
-            char *rhs = src + rhsOffset;
-            switch (op)
-            {
-            case CompOp::E:
-                return strcmp(lhs, rhs) == 0;
-                break;
-            case CompOp::L:
-                return strcmp(lhs, rhs) < 0;
-                break;
-            case CompOp::LE:
-                return strcmp(lhs, rhs) <= 0;
-                break;
-            case CompOp::G:
-                return strcmp(lhs, rhs) > 0;
-                break;
-            case CompOp::GE:
-                return strcmp(lhs, rhs) >= 0;
-                break;
-            case CompOp::NE:
-                return strcmp(lhs, rhs) != 0;
-                break;
-            default:
-                return false;
-                break;
-            }
-        }
-        default:
-            return false;
-            break;
+            mapBase = bpm->mapFile(fileID, fh.numPages);
+            mapPages = fh.numPages;
+            mapFileID = fileID;
         }
+        if (!mapBase)
+            bpm->readSequential(ra, fileID, 1, fh.numPages);
     }
-    bool compareMultiple(DataType src, const std::vector<CompareCondition> &conditions)
+    void unpin()
     {
-        for (auto cond : conditions)
+        guard.release();
+        guardPage = -1;
+    }
+    void unmap()
+    {
+        if (mapBase)
         {
-            if (cond.op == CompOp::IN)
-            {
-                bool flag = false;
-                for (auto val : cond.vals)
-                    if (compareSingle(src, CompOp::E, cond.type, cond.offset, cond.len, reinterpret_cast<void *>(&val), cond.attrIdx))
-                    {
-                        flag = true;
-                        break;
-                    }
-                if (!flag)
-                    return false;
-            }
-            else if (cond.op == CompOp::BETWEEN)
-            {
-                if (!compareSingle(src, CompOp::G, cond.type, cond.offset, cond.len, reinterpret_cast<void *>(&cond.vals[0]), cond.attrIdx) || !compareSingle(src, CompOp::L, cond.type, cond.offset, cond.len, reinterpret_cast<void *>(&cond.vals[1]), cond.attrIdx))
-                    return false;
-            }
-            else if (cond.op == CompOp::BETWEENL)
-            {
-                if (!compareSingle(src, CompOp::GE, cond.type, cond.offset, cond.len, reinterpret_cast<void *>(&cond.vals[0]), cond.attrIdx) || !compareSingle(src, CompOp::L, cond.type, cond.offset, cond.len, reinterpret_cast<void *>(&cond.vals[1]), cond.attrIdx))
-                    return false;
-            }
-            else if (cond.op == CompOp::BETWEENR)
-            {
-                if (!compareSingle(src, CompOp::G, cond.type, cond.offset, cond.len, reinterpret_cast<void *>(&cond.vals[0]), cond.attrIdx) || !compareSingle(src, CompOp::LE, cond.type, cond.offset, cond.len, reinterpret_cast<void *>(&cond.vals[1]), cond.attrIdx))
-                    return false;
-            }
-            else if (cond.op == CompOp::BETWEENLR)
-            {
-                if (!compareSingle(src, CompOp::GE, cond.type, cond.offset, cond.len, reinterpret_cast<void *>(&cond.vals[0]), cond.attrIdx) || !compareSingle(src, CompOp::LE, cond.type, cond.offset, cond.len, reinterpret_cast<void *>(&cond.vals[1]), cond.attrIdx))
-                    return false;
-            }
-            else
-            {
-                if (cond.rhsAttr)
-                {
-                    if (!compareSingle(src, cond.op, cond.type, cond.offset, cond.len, cond.rhsOffset))
-                        return false;
-                }
-                else if (!compareSingle(src, cond.op, cond.type, cond.offset, cond.len, reinterpret_cast<void *>(&cond.val), cond.attrIdx))
-                    return false;
-            }
+            bpm->unmapFile(mapBase, mapPages);
+            mapBase = nullptr;
+            mapFileID = -1;
         }
-        return true;
+    }
+    bool compare(DataType src)
+    {
+        return predicate.test(src);
     }
 };
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <string.h>
+
+// Matches strings against an SQL LIKE pattern: % is any run of characters, _ is exactly one.
+// The pattern is split once at its %s; the pieces between them are found left to right, so a
+// match never backtracks. Patterns without _ use strcmp, memcmp and memmem.
+class LikeMatcher
+{
+private:
+    enum Kind
+    {
+        EXACT,
+        PREFIX,
+        SUFFIX,
+        CONTAINS,
+        GENERAL
+    };
+    Kind kind;
+    // pieces between %s; the first and last are anchored unless the pattern starts or ends with %
+    std::vector<std::string> pieces;
+    std::vector<bool> wild;
+    bool hasPercent;
+    size_t minLen;
+
+    bool matchAt(const char *s, int i) const
+    {
+        const std::string &p = pieces[i];
+        if (!wild[i])
+            return memcmp(s, p.data(), p.size()) == 0;
+        for (size_t k = 0; k < p.size(); k++)
+            if (p[k] != '_' && p[k] != s[k])
+                return false;
+        return true;
+    }
+    // Leftmost position of piece i in s[0, n), or nullptr.
+    const char *find(const char *s, size_t n, int i) const
+    {
+        const std::string &p = pieces[i];
+        if (p.size() > n)
+            return nullptr;
+        if (!wild[i])
+        {
+            if (p.size() == 1)
+                return static_cast<const char *>(memchr(s, p[0], n));
+            return static_cast<const char *>(memmem(s, n, p.data(), p.size()));
+        }
+        for (size_t k = 0; k + p.size() <= n; k++)
+            if (matchAt(s + k, i))
+                return s + k;
+        return nullptr;
+    }
+
+public:
+    LikeMatcher()
+    {
+        compile("%");
+    }
+    LikeMatcher(const std::string &pattern)
+    {
+        compile(pattern);
+    }
+    void compile(const std::string &pattern)
+    {
+        pieces.clear();
+        wild.clear();
+        hasPercent = pattern.find('%') != std::string::npos;
+        minLen = 0;
+        size_t start = 0;
+        while (true)
+        {
+            size_t end = pattern.find('%', start);
+            std::string piece = pattern.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            // empty pieces only matter at the ends, where they mark a leading or trailing %
+            if (!piece.empty() || pieces.empty() || end == std::string::npos)
+            {
+                pieces.push_back(piece);
+                wild.push_back(piece.find('_') != std::string::npos);
+                minLen += piece.size();
+            }
+            if (end == std::string::npos)
+                break;
+            start = end + 1;
+        }
+        bool anyWild = false;
+        for (bool w : wild)
+            anyWild = anyWild || w;
+        if (anyWild)
+            kind = GENERAL;
+        else if (!hasPercent)
+            kind = EXACT;
+        else if (pieces.size() == 2 && pieces[1].empty())
+            kind = PREFIX;
+        else if (pieces.size() == 2 && pieces[0].empty())
+            kind = SUFFIX;
+        else if (pieces.size() == 3 && pieces[0].empty() && pieces[2].empty())
+            kind = CONTAINS;
+        else
+            kind = GENERAL;
+    }
+    bool match(const char *s) const
+    {
+        switch (kind)
+        {
+        case EXACT:
+            return strcmp(s, pieces[0].c_str()) == 0;
+        case PREFIX:
+            return strncmp(s, pieces[0].c_str(), pieces[0].size()) == 0;
+        default:
+            break;
+        }
+        size_t n = strlen(s);
+        if (n < minLen)
+            return false;
+        switch (kind)
+        {
+        case SUFFIX:
+            return memcmp(s + n - pieces[1].size(), pieces[1].data(), pieces[1].size()) == 0;
+        case CONTAINS:
+            return find(s, n, 1) != nullptr;
+        default:
+            break;
+        }
+        if (!hasPercent)
+            return n == pieces[0].size() && matchAt(s, 0);
+        int last = pieces.size() - 1;
+        if (!matchAt(s, 0) || !matchAt(s + n - pieces[last].size(), last))
+            return false;
+        const char *pos = s + pieces[0].size();
+        const char *end = s + n - pieces[last].size();
+        for (int i = 1; i < last; i++)
+        {
+            const char *at = find(pos, end - pos, i);
+            if (at == nullptr)
+                return false;
+            pos = at + pieces[i].size();
+        }
+        return true;
+    }
+};
@@ -0,0 +1,558 @@
+#pragma once
+
+#include "constants.h"
+#include "LikeMatcher.hpp"
+#include "../utils/cpu.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+// A list of CompareConditions compiled once into terms whose test functions are instantiated
+// per (operator, type), so a row is checked with one indirect call per condition and no
+// re-dispatch. NULL handling matches the interpreted form: a NULL column fails every value
+// comparison, IS [NOT] NULL reads the bit numbered by the column's offset, and column-to-column
+// comparisons do not look at NULL bits.
+class Predicate
+{
+private:
+    struct Term;
+    typedef bool (*TestFn)(const Term &, const char *);
+    // Batch form of a term: clears the bits of sel for rows base + i * stride, i < n, that fail.
+    typedef void (*BatchFn)(const Term &, const char *, int, int, unsigned long long *);
+
+    struct Term
+    {
+        TestFn test;
+        BatchFn batch;
+        int offset;
+        int rhsOffset;
+        int attrIdx;
+        defaultValue val[2];
+        std::string str[2];
+        std::vector<int> ints;
+        std::vector<float> floats;
+        std::vector<std::string> strs;
+        LikeMatcher like;
+        Term() : test(nullptr), batch(nullptr) {}
+    };
+
+    std::vector<Term> terms;
+
+    static bool isNull(const char *src, int k)
+    {
+        return (src[k >> 3] >> (k & 0x7)) & 1;
+    }
+    // Column and constant readers, picked by a T* tag; VARCHARs are compared in place.
+    static int load(const char *p, int *)
+    {
+        int v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    static float load(const char *p, float *)
+    {
+        float v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    static const char *load(const char *p, const char **)
+    {
+        return p;
+    }
+    template <typename T>
+    static T load(const char *p)
+    {
+        return load(p, (T *)nullptr);
+    }
+    template <typename T>
+    static T rhs(const Term &t, int i)
+    {
+        return rhs(t, i, (T *)nullptr);
+    }
+    template <typename T>
+    static T rhs(const Term &t, int i, T *)
+    {
+        return load<T>(t.val[i].String);
+    }
+    static const char *rhs(const Term &t, int i, const char **)
+    {
+        return t.str[i].c_str();
+    }
+
+    template <CompOp op, typename T>
+    static bool compareValues(T lhs, T rhs)
+    {
+        switch (op)
+        {
+        case CompOp::E:
+            return lhs == rhs;
+        case CompOp::L:
+            return lhs < rhs;
+        case CompOp::LE:
+            return lhs <= rhs;
+        case CompOp::G:
+            return lhs > rhs;
+        case CompOp::GE:
+            return lhs >= rhs;
+        case CompOp::NE:
+            return lhs != rhs;
+        default:
+            return false;
+        }
+    }
+    template <CompOp op>
+    static bool compareValues(const char *lhs, const char *rhs)
+    {
+        return compareValues<op>(strcmp(lhs, rhs), 0);
+    }
+
+    static bool testFalse(const Term &, const char *)
+    {
+        return false;
+    }
+    static bool testNull(const Term &t, const char *src)
+    {
+        return isNull(src, t.offset);
+    }
+    static bool testNotNull(const Term &t, const char *src)
+    {
+        return !isNull(src, t.offset);
+    }
+    template <CompOp op, typename T>
+    static bool testValue(const Term &t, const char *src)
+    {
+        if (t.attrIdx >= 0 && isNull(src, t.attrIdx))
+            return false;
+        return compareValues<op>(load<T>(src + t.offset), rhs<T>(t, 0));
+    }
+    template <CompOp op, typename T>
+    static bool testColumns(const Term &t, const char *src)
+    {
+        return compareValues<op>(load<T>(src + t.offset), load<T>(src + t.rhsOffset));
+    }
+    template <CompOp lo, CompOp hi, typename T>
+    static bool testBetween(const Term &t, const char *src)
+    {
+        if (isNull(src, t.attrIdx))
+            return false;
+        T v = load<T>(src + t.offset);
+        return compareValues<lo>(v, rhs<T>(t, 0)) && compareValues<hi>(v, rhs<T>(t, 1));
+    }
+    template <typename T>
+    static bool testIn(const Term &t, const char *src)
+    {
+        if (isNull(src, t.attrIdx))
+            return false;
+        return contains(t, load<T>(src + t.offset));
+    }
+    static bool testLike(const Term &t, const char *src)
+    {
+        if (t.attrIdx >= 0 && isNull(src, t.attrIdx))
+            return false;
+        return t.like.match(src + t.offset);
+    }
+
+    static bool contains(const Term &t, int v)
+    {
+        return std::binary_search(t.ints.begin(), t.ints.end(), v);
+    }
+    static bool contains(const Term &t, float v)
+    {
+        return v == v && std::binary_search(t.floats.begin(), t.floats.end(), v);
+    }
+    static bool contains(const Term &t, const char *v)
+    {
+        auto it = std::lower_bound(t.strs.begin(), t.strs.end(), v, [](const std::string &a, const char *b) { return strcmp(a.c_str(), b) < 0; });
+        return it != t.strs.end() && strcmp(it->c_str(), v) == 0;
+    }
+
+    template <template <CompOp, typename> class Fn, typename T>
+    static TestFn pick(CompOp op)
+    {
+        switch (op)
+        {
+        case CompOp::E:
+            return &Fn<CompOp::E, T>::test;
+        case CompOp::L:
+            return &Fn<CompOp::L, T>::test;
+        case CompOp::LE:
+            return &Fn<CompOp::LE, T>::test;
+        case CompOp::G:
+            return &Fn<CompOp::G, T>::test;
+        case CompOp::GE:
+            return &Fn<CompOp::GE, T>::test;
+        case CompOp::NE:
+            return &Fn<CompOp::NE, T>::test;
+        default:
+            return &testFalse;
+        }
+    }
+    template <template <CompOp, typename> class Fn>
+    static TestFn pick(CompOp op, AttrType type)
+    {
+        switch (type)
+        {
+        case AttrType::INT:
+            return pick<Fn, int>(op);
+        case AttrType::FLOAT:
+            return pick<Fn, float>(op);
+        case AttrType::VARCHAR:
+            return pick<Fn, const char *>(op);
+        default:
+            return &testFalse;
+        }
+    }
+    template <CompOp op, typename T>
+    struct Value
+    {
+        static bool test(const Term &t, const char *src) { return testValue<op, T>(t, src); }
+    };
+    template <CompOp op, typename T>
+    struct Columns
+    {
+        static bool test(const Term &t, const char *src) { return testColumns<op, T>(t, src); }
+    };
+    template <CompOp lo, CompOp hi>
+    static TestFn between(AttrType type)
+    {
+        switch (type)
+        {
+        case AttrType::INT:
+            return &testBetween<lo, hi, int>;
+        case AttrType::FLOAT:
+            return &testBetween<lo, hi, float>;
+        case AttrType::VARCHAR:
+            return &testBetween<lo, hi, const char *>;
+        default:
+            return &testFalse;
+        }
+    }
+
+    // Bit j set when row j of the batch is NULL in the term's column; single-condition terms ignore NULLs.
+    static unsigned long long nullMask(const Term &t, const char *row, int stride, int count)
+    {
+        unsigned long long m = 0;
+        if (t.attrIdx < 0)
+            return 0;
+        const char *p = row + (t.attrIdx >> 3);
+        int b = t.attrIdx & 0x7;
+        for (int j = 0; j < count; j++, p += stride)
+            m |= (unsigned long long)((*p >> b) & 1) << j;
+        return m;
+    }
+    template <CompOp op, typename T>
+    static unsigned long long matchScalar(const char *p, int stride, int count, T c)
+    {
+        unsigned long long m = 0;
+        for (int j = 0; j < count; j++, p += stride)
+            m |= (unsigned long long)compareValues<op>(load<T>(p), c) << j;
+        return m;
+    }
+#ifdef CPU_AVX2
+    template <CompOp op>
+    __attribute__((target("avx2"))) static __m256i compare8(__m256i v, __m256i c)
+    {
+        switch (op)
+        {
+        case CompOp::E:
+            return _mm256_cmpeq_epi32(v, c);
+        case CompOp::L:
+            return _mm256_cmpgt_epi32(c, v);
+        case CompOp::LE:
+            return _mm256_xor_si256(_mm256_cmpgt_epi32(v, c), _mm256_set1_epi32(-1));
+        case CompOp::G:
+            return _mm256_cmpgt_epi32(v, c);
+        case CompOp::GE:
+            return _mm256_xor_si256(_mm256_cmpgt_epi32(c, v), _mm256_set1_epi32(-1));
+        default:
+            return _mm256_xor_si256(_mm256_cmpeq_epi32(v, c), _mm256_set1_epi32(-1));
+        }
+    }
+    // Same results as the C++ operators, including NaN: only != holds for unordered values.
+    template <CompOp op>
+    __attribute__((target("avx2"))) static __m256 compare8(__m256 v, __m256 c)
+    {
+        switch (op)
+        {
+        case CompOp::E:
+            return _mm256_cmp_ps(v, c, _CMP_EQ_OQ);
+        case CompOp::L:
+            return _mm256_cmp_ps(v, c, _CMP_LT_OQ);
+        case CompOp::LE:
+            return _mm256_cmp_ps(v, c, _CMP_LE_OQ);
+        case CompOp::G:
+            return _mm256_cmp_ps(v, c, _CMP_GT_OQ);
+        case CompOp::GE:
+            return _mm256_cmp_ps(v, c, _CMP_GE_OQ);
+        default:
+            return _mm256_cmp_ps(v, c, _CMP_NEQ_UQ);
+        }
+    }
+    // Gathers the column of 8 rows at a time; rows are stride bytes apart.
+    template <CompOp op>
+    __attribute__((target("avx2"))) static unsigned long long matchAVX2(const char *p, int stride, int count, int c)
+    {
+        __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+        __m256i vc = _mm256_set1_epi32(c);
+        unsigned long long m = 0;
+        int j = 0;
+        for (; j + 8 <= count; j += 8)
+        {
+            __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int *>(p + (size_t)j * stride), idx, 1);
+            m |= (unsigned long long)(unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(compare8<op>(v, vc))) << j;
+        }
+        if (j < count)
+            m |= matchScalar<op, int>(p + (size_t)j * stride, stride, count - j, c) << j;
+        return m;
+    }
+    template <CompOp op>
+    __attribute__((target("avx2"))) static unsigned long long matchAVX2(const char *p, int stride, int count, float c)
+    {
+        __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+        __m256 vc = _mm256_set1_ps(c);
+        unsigned long long m = 0;
+        int j = 0;
+        for (; j + 8 <= count; j += 8)
+        {
+            __m256 v = _mm256_i32gather_ps(reinterpret_cast<const float *>(p + (size_t)j * stride), idx, 1);
+            m |= (unsigned long long)(unsigned)_mm256_movemask_ps(compare8<op>(v, vc)) << j;
+        }
+        if (j < count)
+            m |= matchScalar<op, float>(p + (size_t)j * stride, stride, count - j, c) << j;
+        return m;
+    }
+#endif
+    template <CompOp op, typename T>
+    static unsigned long long match(const char *p, int stride, int count, T c)
+    {
+#ifdef CPU_AVX2
+        if (hasAVX2())
+            return matchAVX2<op>(p, stride, count, c);
+#endif
+        return matchScalar<op, T>(p, stride, count, c);
+    }
+    template <CompOp op, typename T>
+    static void batchValue(const Term &t, const char *base, int stride, int n, unsigned long long *sel)
+    {
+        T c = rhs<T>(t, 0);
+        for (int w = 0; (w << 6) < n; w++)
+        {
+            if (sel[w] == 0)
+                continue;
+            int count = std::min(64, n - (w << 6));
+            const char *row = base + (size_t)(w << 6) * stride;
+            sel[w] &= match<op, T>(row + t.offset, stride, count, c) & ~nullMask(t, row, stride, count);
+        }
+    }
+    template <CompOp lo, CompOp hi, typename T>
+    static void batchBetween(const Term &t, const char *base, int stride, int n, unsigned long long *sel)
+    {
+        T c0 = rhs<T>(t, 0), c1 = rhs<T>(t, 1);
+        for (int w = 0; (w << 6) < n; w++)
+        {
+            if (sel[w] == 0)
+                continue;
+            int count = std::min(64, n - (w << 6));
+            const char *row = base + (size_t)(w << 6) * stride;
+            sel[w] &= match<lo, T>(row + t.offset, stride, count, c0) & match<hi, T>(row + t.offset, stride, count, c1) & ~nullMask(t, row, stride, count);
+        }
+    }
+    template <typename T>
+    static BatchFn pickBatch(CompOp op)
+    {
+        switch (op)
+        {
+        case CompOp::E:
+            return &batchValue<CompOp::E, T>;
+        case CompOp::L:
+            return &batchValue<CompOp::L, T>;
+        case CompOp::LE:
+            return &batchValue<CompOp::LE, T>;
+        case CompOp::G:
+            return &batchValue<CompOp::G, T>;
+        case CompOp::GE:
+            return &batchValue<CompOp::GE, T>;
+        case CompOp::NE:
+            return &batchValue<CompOp::NE, T>;
+        default:
+            return nullptr;
+        }
+    }
+    static BatchFn pickBatch(CompOp op, AttrType type)
+    {
+        if (type == AttrType::INT)
+            return pickBatch<int>(op);
+        if (type == AttrType::FLOAT)
+            return pickBatch<float>(op);
+        return nullptr;
+    }
+    template <CompOp lo, CompOp hi>
+    static BatchFn betweenBatch(AttrType type)
+    {
+        if (type == AttrType::INT)
+            return &batchBetween<lo, hi, int>;
+        if (type == AttrType::FLOAT)
+            return &batchBetween<lo, hi, float>;
+        return nullptr;
+    }
+
+    static void setConstant(Term &t, int i, AttrType type, const void *val)
+    {
+        if (type == AttrType::VARCHAR)
+            t.str[i].assign(reinterpret_cast<const char *>(val), strnlen(reinterpret_cast<const char *>(val), VARCHAR_MAX_BYTES));
+        else if (type == AttrType::INT || type == AttrType::FLOAT)
+            memcpy(t.val[i].String, val, 4);
+    }
+    static void setIn(Term &t, AttrType type, const std::vector<defaultValue> &vals)
+    {
+        for (const auto &v : vals)
+        {
+            if (type == AttrType::INT)
+                t.ints.push_back(v.Int);
+            else if (type == AttrType::FLOAT && v.Float == v.Float)
+                t.floats.push_back(v.Float);
+            else if (type == AttrType::VARCHAR)
+                t.strs.push_back(std::string(v.String, strnlen(v.String, VARCHAR_MAX_BYTES)));
+        }
+        std::sort(t.ints.begin(), t.ints.end());
+        std::sort(t.floats.begin(), t.floats.end());
+        std::sort(t.strs.begin(), t.strs.end(), [](const std::string &a, const std::string &b) { return strcmp(a.c_str(), b.c_str()) < 0; });
+        switch (type)
+        {
+        case AttrType::INT:
+            t.test = &testIn<int>;
+            break;
+        case AttrType::FLOAT:
+            t.test = &testIn<float>;
+            break;
+        case AttrType::VARCHAR:
+            t.test = &testIn<const char *>;
+            break;
+        default:
+            t.test = &testFalse;
+            break;
+        }
+    }
+    static void setLike(Term &t)
+    {
+        t.like.compile(t.str[0]);
+        t.test = &testLike;
+    }
+    // attrIdx < 0 compiles a condition of a single-condition scan, which does not check NULL bits.
+    bool add(CompOp op, AttrType type, int offset, int attrIdx, const void *val)
+    {
+        Term t;
+        t.offset = offset;
+        t.rhsOffset = -1;
+        t.attrIdx = attrIdx;
+        if (op == CompOp::NO)
+            return true;
+        if (op == CompOp::ISNULL)
+            t.test = &testNull;
+        else if (op == CompOp::ISNOTNULL)
+            t.test = &testNotNull;
+        else if (op == CompOp::LIKE && type == AttrType::VARCHAR)
+        {
+            setConstant(t, 0, type, val);
+            setLike(t);
+        }
+        else
+        {
+            setConstant(t, 0, type, val);
+            t.test = pick<Value>(op, type);
+            t.batch = pickBatch(op, type);
+        }
+        terms.push_back(t);
+        return true;
+    }
+
+public:
+    Predicate() {}
+    Predicate(const std::vector<CompareCondition> &conditions)
+    {
+        compile(conditions);
+    }
+    // The condition of a single-condition scan; val points to a value of the column's type.
+    bool compile(CompOp op, AttrType type, int offset, const void *val)
+    {
+        terms.clear();
+        return add(op, type, offset, -1, val);
+    }
+    bool compile(const std::vector<CompareCondition> &conditions)
+    {
+        terms.clear();
+        for (const auto &cond : conditions)
+        {
+            Term t;
+            t.offset = cond.offset;
+            t.rhsOffset = cond.rhsOffset;
+            t.attrIdx = cond.attrIdx;
+            if (cond.op == CompOp::IN)
+                setIn(t, cond.type, cond.vals);
+            else if (cond.op >= CompOp::BETWEEN && cond.op <= CompOp::BETWEENLR)
+            {
+                setConstant(t, 0, cond.type, cond.vals[0].String);
+                setConstant(t, 1, cond.type, cond.vals[1].String);
+                if (cond.op == CompOp::BETWEEN)
+                {
+                    t.test = between<CompOp::G, CompOp::L>(cond.type);
+                    t.batch = betweenBatch<CompOp::G, CompOp::L>(cond.type);
+                }
+                else if (cond.op == CompOp::BETWEENL)
+                {
+                    t.test = between<CompOp::GE, CompOp::L>(cond.type);
+                    t.batch = betweenBatch<CompOp::GE, CompOp::L>(cond.type);
+                }
+                else if (cond.op == CompOp::BETWEENR)
+                {
+                    t.test = between<CompOp::G, CompOp::LE>(cond.type);
+                    t.batch = betweenBatch<CompOp::G, CompOp::LE>(cond.type);
+                }
+                else
+                {
+                    t.test = between<CompOp::GE, CompOp::LE>(cond.type);
+                    t.batch = betweenBatch<CompOp::GE, CompOp::LE>(cond.type);
+                }
+            }
+            else if (cond.rhsAttr)
+                t.test = pick<Columns>(cond.op, cond.type);
+            else
+            {
+                add(cond.op, cond.type, cond.offset, cond.attrIdx, cond.val.String);
+                continue;
+            }
+            terms.push_back(t);
+        }
+        return true;
+    }
+    bool test(const char *src) const
+    {
+        for (const auto &t : terms)
+            if (!t.test(t, src))
+                return false;
+        return true;
+    }
+    // Tests the rows base + i * stride, i < n, clearing the bit of sel for every row that fails.
+    // INT and FLOAT comparisons run over the whole batch, with AVX2 when the CPU has it; the
+    // other terms are tested row by row on the rows still selected.
+    void filter(const char *base, int stride, int n, unsigned long long *sel) const
+    {
+        int words = (n + 63) >> 6;
+        for (const auto &t : terms)
+        {
+            if (t.batch)
+            {
+                t.batch(t, base, stride, n, sel);
+                continue;
+            }
+            for (int w = 0; w < words; w++)
+                for (unsigned long long m = sel[w]; m; m &= m - 1)
+                {
+                    int i = (w << 6) + __builtin_ctzll(m);
+                    if (!t.test(t, base + (size_t)i * stride))
+                        sel[w] &= ~(1ULL << (i & 63));
+                }
+        }
+    }
+};
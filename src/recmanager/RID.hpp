@@ -12,7 +12,6 @@ public:
         pageID = _pageID;
         slotID = _slotID;
     }
-    ~RID() {}
     bool getPageID(int &_pageID) const
     {
         _pageID = pageID;
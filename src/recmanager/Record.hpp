@@ -26,8 +26,43 @@ public:
     {
         rid = _rec.rid;
         recSize = _rec.recSize;
-        pData = new char[recSize];
-        memcpy(pData, _rec.pData, recSize);
+        pData = nullptr;
+        if (_rec.pData)
+        {
+            pData = new char[recSize];
+            memcpy(pData, _rec.pData, recSize);
+        }
+    }
+    Record(Record &&_rec)
+    {
+        rid = _rec.rid;
+        recSize = _rec.recSize;
+        pData = _rec.pData;
+        _rec.pData = nullptr;
+    }
+    Record &operator=(const Record &_rec)
+    {
+        if (this != &_rec)
+        {
+            if (_rec.pData)
+                set(_rec.rid, _rec.pData, _rec.recSize);
+            else
+                rid = _rec.rid;
+        }
+        return *this;
+    }
+    Record &operator=(Record &&_rec)
+    {
+        if (this != &_rec)
+        {
+            if (pData)
+                delete[] pData;
+            rid = _rec.rid;
+            recSize = _rec.recSize;
+            pData = _rec.pData;
+            _rec.pData = nullptr;
+        }
+        return *this;
     }
     ~Record()
     {
@@ -57,5 +92,48 @@ public:
         recSize = _recSize;
 
         memcpy(pData, _pData, recSize);
+        return true;
+    }
+};
+
+// A record read in place: data points into a pinned page or a scan buffer and stays valid
+// only until the scan or handle that filled it moves on. Copy it into a Record to keep it.
+class RecordView
+{
+private:
+    RID rid;
+    int recSize;
+    DataType pData;
+
+public:
+    RecordView()
+    {
+        recSize = 0;
+        pData = nullptr;
+    }
+    bool getData(DataType &_pData) const
+    {
+        _pData = pData;
+        return true;
+    }
+    bool getRID(RID &_rid) const
+    {
+        _rid = rid;
+        return true;
+    }
+    int size() const
+    {
+        return recSize;
+    }
+    bool set(const RID &_rid, DataType _pData, int _recSize)
+    {
+        rid = _rid;
+        pData = _pData;
+        recSize = _recSize;
+        return true;
+    }
+    Record materialize() const
+    {
+        return Record(rid, pData, recSize);
     }
 };
@@ -7,6 +7,7 @@
 #include "FileHandle.hpp"
 #include "../fileio/FileManager.h"
 #include "../bufmanager/BufPageManager.h"
+#include "../bufmanager/FileCache.h"
 
 class RecordManager
 {
@@ -14,6 +15,7 @@ private:
     FileManager *fm;
     BufPageManager *bpm;
     std::map<std::string, int> openedMap;
+    FileCache cache;
 
 public:
     RecordManager() {}
@@ -21,6 +23,7 @@ public:
     {
         fm = _fm;
         bpm = _bpm;
+        cache = FileCache(fm, bpm);
     }
     ~RecordManager()
     {
@@ -28,8 +31,10 @@ public:
         bpm = nullptr;
     }
 
-    bool createFile(const std::string filename, int slotSize)
+    // `slotted` selects the slotted-page format for this file; see SlottedPage.hpp.
+    bool createFile(const std::string filename, int slotSize, bool slotted = defaultSlotted())
     {
+        cache.drop(filename);
         fm->createFile(filename.c_str());
         int fileID;
         fm->openFile(filename.c_str(), fileID);
@@ -37,30 +42,56 @@ public:
         int index;
         BufType b = bpm->allocPage(fileID, pageID, index, false);
         DataType d = reinterpret_cast<DataType>(b);
+        memset(d, 0, PAGE_SIZE);
         FileHeader fh;
         fh.firstFree = 1;
         fh.numPages = 1;
         fh.slotSize = slotSize;
-        fh.slotMapSize = PAGE_SIZE / (1 + slotSize * 8) + 1;
-        fh.capacity = (PAGE_SIZE - fh.slotMapSize) / fh.slotSize;
+        if (slotted)
+        {
+            fh.slotMapSize = sizeof(SlotPageHeader);
+            fh.capacity = (PAGE_SIZE - fh.slotMapSize) / (sizeof(SlotEntry) + SLOT_MIN_TUPLE);
+        }
+        else
+        {
+            fh.slotMapSize = PAGE_SIZE / (1 + slotSize * 8) + 1;
+            fh.capacity = (PAGE_SIZE - fh.slotMapSize) / fh.slotSize;
+        }
         memcpy(d, &fh, sizeof(fh));
+        FreeSpaceMap(d).init();
+        if (slotted)
+            setSlottedFile(d);
         bpm->markDirty(index);
-        bpm->close();
-        fm->closeFile(fileID);
+        cache.put(filename, fileID);
         return true;
     }
     bool destroyFile(const std::string filename)
     {
+        cache.drop(filename);
+        auto it = openedMap.find(filename);
+        if (it != openedMap.end())
+        {
+            bpm->dropFile(it->second);
+            fm->closeFile(it->second);
+            openedMap.erase(it);
+        }
         remove(filename.c_str());
         return true;
     }
+    // Forgets every kept-open file under `prefix`, e.g. before removing a database directory.
+    bool destroyFiles(const std::string prefix)
+    {
+        cache.dropPrefix(prefix);
+        return true;
+    }
     bool openFile(const std::string filename, FileHandle &fileHandle)
     {
         auto it = openedMap.find(filename);
         if (it != openedMap.end())
             return false;
         int fileID;
-        fm->openFile(filename.c_str(), fileID);
+        if (!cache.take(filename, fileID))
+            fm->openFile(filename.c_str(), fileID);
         openedMap[filename] = fileID;
         fileHandle = FileHandle(fileID, bpm);
         return true;
@@ -70,8 +101,8 @@ public:
         auto it = openedMap.find(filename);
         if (it == openedMap.end())
             return false;
-        bpm->close();
-        fm->closeFile(it->second);
+        // keep the file and its cached pages around for the next statement
+        cache.put(filename, it->second);
         openedMap.erase(it);
         return true;
     }
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "../utils/pagedef.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Heap files come in two formats. Fixed files keep every record in a slotSize slot behind a
+// SlotMap. Slotted files keep a directory of variable-length tuples per page; a record is
+// stored with its runs of zero bytes (NUL padding of VARCHARs, unused names) elided and is
+// expanded back to slotSize bytes when read, so the layers above see the same layout.
+#define RECORD_FORMAT_OFFSET 24
+#define SLOTTED_MAGIC 0x544f4c53
+
+// Zero runs shorter than this are kept as literals; every run costs a 4-byte run header.
+#define ZERO_RUN_MIN 8
+// Every tuple takes at least the space of a forwarding stub so it can become one in place.
+#define SLOT_MIN_TUPLE 8
+// Directory entry flags, kept in the top bits of the length.
+#define SLOT_FORWARD 0x8000
+#define SLOT_MOVED 0x4000
+#define SLOT_LEN_MASK 0x3fff
+
+static_assert(PAGE_SIZE <= SLOT_LEN_MASK + 1, "slotted pages store 14-bit tuple lengths");
+
+inline bool slottedFile(const DataType header)
+{
+    unsigned int magic;
+    memcpy(&magic, &header[RECORD_FORMAT_OFFSET], sizeof(magic));
+    return magic == SLOTTED_MAGIC;
+}
+
+inline void setSlottedFile(DataType header)
+{
+    unsigned int magic = SLOTTED_MAGIC;
+    memcpy(&header[RECORD_FORMAT_OFFSET], &magic, sizeof(magic));
+}
+
+// MINISQL_RECORD_FORMAT=slotted makes heap files created from now on slotted.
+inline bool defaultSlotted()
+{
+    const char *env = getenv("MINISQL_RECORD_FORMAT");
+    return env != nullptr && strcmp(env, "slotted") == 0;
+}
+
+// Largest encoded size of a size-byte record.
+inline int maxEncodedSize(int size)
+{
+    return size + 4 < SLOT_MIN_TUPLE ? SLOT_MIN_TUPLE : size + 4;
+}
+
+// Encodes src as runs of {literal length, zero count, literal bytes}; returns the encoded length.
+inline int encodeRecord(const char *src, int size, char *dst)
+{
+    int n = 0, i = 0;
+    while (i < size)
+    {
+        int lit = i, zeros = 0;
+        while (lit < size)
+        {
+            if (src[lit] != 0)
+            {
+                lit++;
+                continue;
+            }
+            int end = lit;
+            while (end < size && src[end] == 0)
+                end++;
+            if (end - lit >= ZERO_RUN_MIN || end == size)
+            {
+                zeros = end - lit;
+                break;
+            }
+            lit = end;
+        }
+        unsigned short run[2] = {(unsigned short)(lit - i), (unsigned short)zeros};
+        memcpy(dst + n, run, sizeof(run));
+        memcpy(dst + n + sizeof(run), src + i, lit - i);
+        n += sizeof(run) + lit - i;
+        i = lit + zeros;
+    }
+    return n;
+}
+
+inline void decodeRecord(const char *src, char *dst, int size)
+{
+    int i = 0;
+    while (i < size)
+    {
+        unsigned short run[2];
+        memcpy(run, src, sizeof(run));
+        memcpy(dst + i, src + sizeof(run), run[0]);
+        memset(dst + i + run[0], 0, run[1]);
+        src += sizeof(run) + run[0];
+        i += run[0] + run[1];
+    }
+}
+
+struct SlotPageHeader
+{
+    unsigned short slotCount;
+    unsigned short freeEnd;
+    unsigned short freeBytes;
+    unsigned short reserved;
+};
+
+struct SlotEntry
+{
+    unsigned short offset;
+    unsigned short len;
+};
+
+// A slotted page: the header, then the slot directory growing up, then tuples growing down
+// from the end of the page. An entry with offset 0 is free. A SLOT_FORWARD entry holds the RID
+// a grown tuple was moved to; the moved tuple is marked SLOT_MOVED so scans skip it.
+class SlottedPage
+{
+public:
+    DataType page;
+    SlottedPage(DataType _page) : page(_page) {}
+    SlotPageHeader *header() const
+    {
+        return reinterpret_cast<SlotPageHeader *>(page);
+    }
+    SlotEntry *entry(int slotID) const
+    {
+        return reinterpret_cast<SlotEntry *>(page + sizeof(SlotPageHeader)) + slotID;
+    }
+    void init()
+    {
+        header()->slotCount = 0;
+        header()->freeEnd = PAGE_SIZE;
+        header()->freeBytes = PAGE_SIZE - sizeof(SlotPageHeader);
+        header()->reserved = 0;
+    }
+    int count() const
+    {
+        return header()->slotCount;
+    }
+    bool used(int slotID) const
+    {
+        return slotID < count() && entry(slotID)->offset != 0;
+    }
+    int flags(int slotID) const
+    {
+        return entry(slotID)->len & ~SLOT_LEN_MASK;
+    }
+    int length(int slotID) const
+    {
+        return entry(slotID)->len & SLOT_LEN_MASK;
+    }
+    DataType tuple(int slotID) const
+    {
+        return page + entry(slotID)->offset;
+    }
+    // Whether a tuple of n bytes fits, counting a new directory entry.
+    bool fits(int n) const
+    {
+        return header()->freeBytes >= (n < SLOT_MIN_TUPLE ? SLOT_MIN_TUPLE : n) + (int)sizeof(SlotEntry);
+    }
+    // Stores a tuple in the first free entry; returns its slot or -1 if the page is full.
+    int insert(const char *data, int n, int flag)
+    {
+        int slotID = 0;
+        while (slotID < count() && entry(slotID)->offset != 0)
+            slotID++;
+        return put(slotID, data, n, flag) ? slotID : -1;
+    }
+    // Rewrites a tuple in its slot, moving it within the page if it grew; false if it does not fit.
+    bool replace(int slotID, const char *data, int n, int flag)
+    {
+        int len = n < SLOT_MIN_TUPLE ? SLOT_MIN_TUPLE : n;
+        int oldLen = length(slotID);
+        if (len <= oldLen)
+        {
+            memcpy(tuple(slotID), data, n);
+            entry(slotID)->len = len | flag;
+            header()->freeBytes += oldLen - len;
+            return true;
+        }
+        if (header()->freeBytes + oldLen < len)
+            return false;
+        release(slotID);
+        return put(slotID, data, n, flag);
+    }
+    void remove(int slotID)
+    {
+        release(slotID);
+        while (count() > 0 && entry(count() - 1)->offset == 0)
+        {
+            header()->slotCount--;
+            header()->freeBytes += sizeof(SlotEntry);
+        }
+    }
+    // Moves every tuple to the end of the page so the free bytes are contiguous.
+    void compact()
+    {
+        char tmp[PAGE_SIZE];
+        memcpy(tmp, page, PAGE_SIZE);
+        int end = PAGE_SIZE;
+        for (int i = 0; i < count(); i++)
+        {
+            SlotEntry *e = entry(i);
+            if (e->offset == 0)
+                continue;
+            int len = e->len & SLOT_LEN_MASK;
+            end -= len;
+            memcpy(page + end, tmp + e->offset, len);
+            e->offset = end;
+        }
+        header()->freeEnd = end;
+    }
+
+private:
+    bool put(int slotID, const char *data, int n, int flag)
+    {
+        int len = n < SLOT_MIN_TUPLE ? SLOT_MIN_TUPLE : n;
+        int need = len + (slotID == count() ? sizeof(SlotEntry) : 0);
+        if (header()->freeBytes < need)
+            return false;
+        int dirEnd = sizeof(SlotPageHeader) + sizeof(SlotEntry) * (count() + (slotID == count()));
+        if (header()->freeEnd - dirEnd < len)
+            compact();
+        if (slotID == count())
+            header()->slotCount++;
+        header()->freeEnd -= len;
+        header()->freeBytes -= need;
+        memcpy(page + header()->freeEnd, data, n);
+        entry(slotID)->offset = header()->freeEnd;
+        entry(slotID)->len = len | flag;
+        return true;
+    }
+    void release(int slotID)
+    {
+        SlotEntry *e = entry(slotID);
+        int len = e->len & SLOT_LEN_MASK;
+        if (e->offset == header()->freeEnd)
+            header()->freeEnd += len;
+        header()->freeBytes += len;
+        e->offset = 0;
+        e->len = 0;
+    }
+};
@@ -3,6 +3,8 @@
 #include "../utils/pagedef.h"
 
 #include <vector>
+#include <string>
+#include <string.h>
 
 #define DBNAME_MAX_BYTES 100
 #define RELNAME_MAX_BYTES 100
@@ -120,4 +122,80 @@ public:
         map[k >> 3] &= ~(1 << (k & 0x7));
         return true;
     }
-};
\ No newline at end of file
+    // First clear bit at or after `from`, or -1; scans 64 slots per step.
+    int findFree(int from = 0)
+    {
+        for (int k = from & ~63; k < size; k += 64)
+        {
+            unsigned long long w = 0;
+            int bytes = (size - k + 7) >> 3;
+            memcpy(&w, &map[k >> 3], bytes < 8 ? bytes : 8);
+            w = ~w;
+            if (k < from)
+                w &= ~0ULL << (from - k);
+            if (size - k < 64)
+                w &= (1ULL << (size - k)) - 1;
+            if (w != 0)
+                return k + __builtin_ctzll(w);
+        }
+        return -1;
+    }
+};
+
+// Free-space map stored in page 0 right after the FileHeader: one bit per data page,
+// set while the page still has a free slot. Files without FSM_MAGIC get the map rebuilt on open.
+// Pages beyond FSM_PAGES are not tracked and fall back to FileHeader::firstFree.
+#define FSM_MAGIC 0x314d5346
+#define FSM_OFFSET 32
+#define FSM_PAGES ((PAGE_SIZE - FSM_OFFSET) * 8)
+
+class FreeSpaceMap
+{
+public:
+    DataType page;
+    FreeSpaceMap(DataType _page) : page(_page) {}
+    bool valid() const
+    {
+        unsigned int magic;
+        memcpy(&magic, &page[sizeof(FileHeader)], sizeof(magic));
+        return magic == FSM_MAGIC;
+    }
+    void init()
+    {
+        unsigned int magic = FSM_MAGIC;
+        memcpy(&page[sizeof(FileHeader)], &magic, sizeof(magic));
+        memset(&page[FSM_OFFSET], 0, PAGE_SIZE - FSM_OFFSET);
+    }
+    bool test(int pageID) const
+    {
+        return pageID < FSM_PAGES && (page[FSM_OFFSET + (pageID >> 3)] >> (pageID & 0x7) & 1);
+    }
+    bool set(int pageID)
+    {
+        if (pageID >= FSM_PAGES)
+            return false;
+        page[FSM_OFFSET + (pageID >> 3)] |= 1 << (pageID & 0x7);
+        return true;
+    }
+    bool remove(int pageID)
+    {
+        if (pageID >= FSM_PAGES)
+            return false;
+        page[FSM_OFFSET + (pageID >> 3)] &= ~(1 << (pageID & 0x7));
+        return true;
+    }
+    // First page at or after `from` that has a free slot, or -1.
+    int find(int from = 0) const
+    {
+        for (int k = from & ~63; k < FSM_PAGES; k += 64)
+        {
+            unsigned long long w;
+            memcpy(&w, &page[FSM_OFFSET + (k >> 3)], 8);
+            if (k < from)
+                w &= ~0ULL << (from - k);
+            if (w != 0)
+                return k + __builtin_ctzll(w);
+        }
+        return -1;
+    }
+};
@@ -86,6 +86,8 @@ public:
 
         if (rid.valid())
         {
+            rm->destroyFiles(dbName + "/");
+            im->destroyIndexes(dbName + "/");
             std::string prefix = "rm -r ";
             system((prefix + dbName).c_str());
 
@@ -125,6 +127,7 @@ public:
 
         dbOpened = true;
         openedDbName = dbName;
+        rebuildStaleIndexes();
         return true;
     }
     bool closeDb()
@@ -448,18 +451,26 @@ public:
         rm->closeFile(openedDbName + "/" + tableName + ".index");
         delete[] data;
 
+        buildIndex(tableName, indexNo);
+        return true;
+    }
+    // Creates the index file on the columns at offsets indexNo and fills it from the table.
+    void buildIndex(const std::string &tableName, std::vector<int> &indexNo)
+    {
         im->createIndex(openedDbName + "/" + tableName, indexNo, AttrType::INT, 4 * indexNo.size());
         IndexHandle ih;
         im->openIndex(openedDbName + "/" + tableName, indexNo, ih);
         FileHandle fh;
+        FileScan scan;
         rm->openFile(openedDbName + "/" + tableName, fh);
-        scan.openScan(fh, cat->type, cat->typeLen, cat->offset, CompOp::NO, nullptr);
-        while (scan.getNextRec(rec))
+        scan.openScan(fh, AttrType::ANY, 4, 0, CompOp::NO, nullptr);
+        RecordView view;
+        while (scan.getNextView(view))
         {
             DataType tmp;
-            rec.getData(tmp);
+            view.getData(tmp);
             RID rid;
-            rec.getRID(rid);
+            view.getRID(rid);
             std::vector<int> key;
             for (auto offset : indexNo)
             {
@@ -471,7 +482,40 @@ public:
         scan.closeScan();
         rm->closeFile(openedDbName + "/" + tableName);
         im->closeIndex(openedDbName + "/" + tableName, indexNo);
-        return true;
+    }
+    // Rebuilds every index of the open database whose file is in an older node layout.
+    void rebuildStaleIndexes()
+    {
+        std::vector<std::string> tables;
+        FileScan scan;
+        Record rec;
+        rm->openFile(openedDbName + "/relcat", relCatHandle);
+        scan.openScan(relCatHandle, AttrType::ANY, 4, 0, CompOp::NO, nullptr);
+        while (scan.getNextRec(rec))
+        {
+            DataType tmp;
+            rec.getData(tmp);
+            tables.push_back(reinterpret_cast<RelCat *>(tmp)->relName);
+        }
+        scan.closeScan();
+        rm->closeFile(openedDbName + "/relcat");
+
+        for (auto &tableName : tables)
+        {
+            std::vector<std::vector<int>> indexNos;
+            getPrimaryKeyAndIndex(tableName, indexNos);
+            for (auto &indexNo : indexNos)
+            {
+                IndexHandle ih;
+                if (im->openIndex(openedDbName + "/" + tableName, indexNo, ih))
+                {
+                    im->closeIndex(openedDbName + "/" + tableName, indexNo);
+                    continue;
+                }
+                im->destroyIndex(openedDbName + "/" + tableName, indexNo);
+                buildIndex(tableName, indexNo);
+            }
+        }
     }
     bool dropIndex(const std::string tableName, const std::vector<std::string> &attrName)
     {
@@ -1281,11 +1325,11 @@ public:
         rm->openFile(openedDbName + "/" + tableName, fh);
         FileScan fs;
         fs.openScan(fh, AttrType::ANY, -1, -1, CompOp::NO, nullptr);
-        Record rec;
-        while (fs.getNextRec(rec))
+        RecordView view;
+        while (fs.getNextView(view))
         {
             DataType data;
-            rec.getData(data);
+            view.getData(data);
 
             std::string recStr;
             SlotMap nullMap(data, allAttrName.size());
@@ -1,7 +1,6 @@
 #ifndef MY_HASH_MAP
 #define MY_HASH_MAP
 #include "pagedef.h"
-#include "MyLinkList.h"
 /*
  * hash表的键
  */
@@ -18,19 +17,74 @@ struct DataNode {
 /*
  * 两个键的hash表
  * hash表的value是自然数，在缓存管理器中，hash表的value用来表示缓存页面数组的下标
+ * 两个键拼成一个64位整数，经过混合后在开放定址的表中线性探测，表的大小不小于容量的两倍
+ * 一次查找通常只访问一到两个cache line
  */
 class MyHashMap {
 private:
-	static const int A = 1;
-	static const int B = 1;
-	int CAP_, MOD_;
-	MyLinkList* list;
+	/*
+	 * 表中的一项，value为-1表示空位
+	 */
+	struct Slot {
+		unsigned long long key;
+		int value;
+	};
+	int CAP_;
+	unsigned int mask;
+	Slot* table;
 	DataNode* a;
+	static unsigned long long pack(int k1, int k2) {
+		return (((unsigned long long) (unsigned int) k1) << 32) | (unsigned int) k2;
+	}
+	/*
+	 * hash函数，splitmix64的混合步骤，保证不同文件的页面均匀分布
+	 */
+	unsigned int hash(unsigned long long x) {
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9ULL;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111ebULL;
+		x ^= x >> 31;
+		return ((unsigned int) x) & mask;
+	}
+	int findSlot(unsigned long long key) {
+		unsigned int i = hash(key);
+		while (table[i].value != -1) {
+			if (table[i].key == key) {
+				return i;
+			}
+			i = (i + 1) & mask;
+		}
+		return -1;
+	}
 	/*
-	 * hash函数
+	 * 删除第i项，之后的项向前移动填补空位，保证探测序列不断开
 	 */
-	int hash(int k1, int k2) {
-		return (k1 * A + k2 * B) % MOD_;
+	void erase(unsigned int i) {
+		unsigned int j = i;
+		while (true) {
+			j = (j + 1) & mask;
+			if (table[j].value == -1) {
+				break;
+			}
+			unsigned int h = hash(table[j].key);
+			if (((j - h) & mask) >= ((j - i) & mask)) {
+				table[i] = table[j];
+				i = j;
+			}
+		}
+		table[i].value = -1;
+	}
+	void build(int c) {
+		unsigned int size = 1;
+		while (size < 2 * (unsigned int) c) {
+			size <<= 1;
+		}
+		mask = size - 1;
+		table = new Slot[size];
+		for (unsigned int i = 0; i < size; ++ i) {
+			table[i].value = -1;
+		}
 	}
 public:
 	/*
@@ -41,19 +95,8 @@ public:
 	 *           这里的value是自然数，如果没有找到，则返回-1
 	 */
 	int findIndex(int k1, int k2) {
-		int h = hash(k1, k2);
-		int p = list->getFirst(h);
-		while (!list->isHead(p)) {
-			if (a[p].key1 == k1 && a[p].key2 == k2) {
-				/*
-				list.del(p);
-				list.insertFirst(p);
-				*/
-				return p;
-			}
-			p = list->next(p);
-		}
-		return -1;
+		int i = findSlot(pack(k1, k2));
+		return (i == -1) ? -1 : table[i].value;
 	}
 	/*
 	 * @函数名replace
@@ -63,9 +106,14 @@ public:
 	 * 功能:在hash表中，将指定value对应的两个key设置为k1和k2
 	 */
 	void replace(int index, int k1, int k2) {
-		int h = hash(k1, k2);
-		//cout << h << endl;
-		list->insertFirst(h, index);
+		remove(index);
+		unsigned long long key = pack(k1, k2);
+		unsigned int i = hash(key);
+		while (table[i].value != -1 && table[i].key != key) {
+			i = (i + 1) & mask;
+		}
+		table[i].key = key;
+		table[i].value = index;
 		a[index].key1 = k1;
 		a[index].key2 = k2;
 	}
@@ -75,7 +123,13 @@ public:
 	 * 功能:在hash表中，将指定的value删掉
 	 */
 	void remove(int index) {
-		list->del(index);
+		if (a[index].key1 == -1 && a[index].key2 == -1) {
+			return;
+		}
+		int i = findSlot(pack(a[index].key1, a[index].key2));
+		if (i != -1 && table[i].value == index) {
+			erase(i);
+		}
 		a[index].key1 = -1;
 		a[index].key2 = -1;
 	}
@@ -89,20 +143,49 @@ public:
 		k1 = a[index].key1;
 		k2 = a[index].key2;
 	}
+	/*
+	 * @函数名resize
+	 * @参数c:新的容量上限
+	 * 功能:改变容量上限，value不小于c的项必须已经删除
+	 */
+	void resize(int c) {
+		DataNode* b = new DataNode[c];
+		for (int i = 0; i < c; ++ i) {
+			b[i].key1 = -1;
+			b[i].key2 = -1;
+		}
+		for (int i = 0; i < c && i < CAP_; ++ i) {
+			b[i] = a[i];
+		}
+		delete[] table;
+		delete[] a;
+		a = b;
+		CAP_ = c;
+		build(c);
+		for (int i = 0; i < CAP_; ++ i) {
+			if (a[i].key1 != -1 || a[i].key2 != -1) {
+				int k1 = a[i].key1, k2 = a[i].key2;
+				a[i].key1 = a[i].key2 = -1;
+				replace(i, k1, k2);
+			}
+		}
+	}
 	/*
 	 * 构造函数
 	 * @参数c:hash表的容量上限
-	 * @参数m:hash函数的mod
 	 */
-	MyHashMap(int c, int m) {
+	MyHashMap(int c) {
 		CAP_ = c;
-		MOD_ = m;
+		build(c);
 		a = new DataNode[c];
 		for (int i = 0; i < CAP_; ++ i) {
 			a[i].key1 = -1;
 			a[i].key2 = -1;
 		}
-		list = new MyLinkList(CAP_, MOD_);
+	}
+	~MyHashMap() {
+		delete[] table;
+		delete[] a;
 	}
 };
 #endif
@@ -0,0 +1,19 @@
+#ifndef CPU_DEF
+#define CPU_DEF
+/*
+ * GCC在x86上编译时定义CPU_AVX2，可以用target("avx2")编译单个函数
+ * 调用这样的函数之前先用hasAVX2检查运行的CPU是否支持
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CPU_AVX2 1
+/*
+ * @函数名hasAVX2
+ * 返回:运行的CPU是否支持AVX2，只在第一次调用时检查
+ */
+inline bool hasAVX2() {
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+	return avx2;
+}
+#endif
+#endif
@@ -18,18 +18,65 @@
  * 页面字节数以2为底的指数
  */
 #define PAGE_SIZE_IDX 13
+/*
+ * 缓存页面首地址的对齐字节数，满足O_DIRECT对内存地址的要求
+ */
+#define FRAME_ALIGN 4096
+/*
+ * 透明大页和MAP_HUGETLB大页的字节数
+ */
+#define HUGE_PAGE_SIZE (2 << 20)
+/*
+ * 一次向量读写系统调用最多处理的页面个数
+ */
+#define IO_RUN_PAGES 32
+/*
+ * 异步读写队列中最多同时在途的请求个数
+ */
+#define IO_QUEUE_DEPTH 64
+/*
+ * 不支持io_uring时，异步读写线程池中的线程个数
+ */
+#define AIO_THREAD_NUM 4
+/*
+ * 顺序扫描时预读的页面个数
+ */
+#define READ_AHEAD_PAGES 32
+/*
+ * 只读扫描的文件不少于这么多页面时，直接映射文件而不经过缓存
+ */
+#define MMAP_SCAN_MIN_PAGES 64
+/*
+ * 后台写回线程的唤醒间隔(毫秒)，每次检查替换算法最先替换的FLUSH_SCAN_PAGES个页面，
+ * 最多写回其中FLUSH_BATCH_PAGES个脏页
+ */
+#define FLUSH_INTERVAL_MS 50
+#define FLUSH_SCAN_PAGES 512
+#define FLUSH_BATCH_PAGES 64
+/*
+ * 缓存分片个数的上限，每个分片至少有BUF_SHARD_MIN_PAGES个页面
+ */
+#define BUF_SHARD_NUM 16
+#define BUF_SHARD_MIN_PAGES 64
 #define MAX_FMT_INT_NUM 128
 //#define BUF_PAGE_NUM 65536
-#define MAX_FILE_NUM 128
+/*
+ * 同时打开的文件个数上限，文件id小于这个值
+ */
+#define MAX_FILE_NUM 4096
+/*
+ * 同时打开的文件描述符个数上限，打开的文件更多时，描述符按最近最少使用的顺序关闭，用到时重新打开
+ */
+#define MAX_OPEN_FD 64
+/*
+ * 记录管理器和索引管理器各自在关闭后仍保持打开的文件个数上限
+ */
+#define FILE_CACHE_NUM 1024
 #define MAX_TYPE_NUM 256
 /*
  * 缓存中页面个数上限
  */
 #define CAP 60000
-/*
- * hash算法的模
- */
-#define MOD 60000
 #define IN_DEBUG 0
 #define DEBUG_DELETE 0
 #define DEBUG_ERASE 1